@@ -0,0 +1,280 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CATS_TEXTCAT_BENCH_BENCH_HPP
+#define CATS_TEXTCAT_BENCH_BENCH_HPP
+
+
+#include <chrono>
+#include <cstdint>
+
+#include <string>
+#include <vector>
+
+
+namespace Corpus {
+
+enum class Kind {
+    
+    AttributeHeavy,
+    TextHeavy,
+    DeepNesting,
+    EntityHeavy,
+    CDATAHeavy,
+    FlatRecords,
+    
+};
+
+static const Kind kinds[] = {Kind::AttributeHeavy, Kind::TextHeavy, Kind::DeepNesting, Kind::EntityHeavy, Kind::CDATAHeavy, Kind::FlatRecords};
+
+inline const char* getName(Kind kind) {
+    
+    switch(kind) {
+    
+    case Kind::AttributeHeavy: return "attribute";
+    case Kind::TextHeavy: return "text";
+    case Kind::DeepNesting: return "deep";
+    case Kind::EntityHeavy: return "entity";
+    case Kind::CDATAHeavy: return "cdata";
+    case Kind::FlatRecords: return "flat";
+    default: return "unknown";
+        
+    }
+
+}
+
+// A reproducible pseudo-random source of words
+class Random {
+    
+private:
+    
+    std::uint32_t seed;
+    
+public:
+    
+    Random() : seed(1) {}
+    
+    std::uint32_t next() { seed = seed * 1103515245 + 12345; return seed >> 16; }
+    std::string word() {
+        
+        static const char* const words[] = {"lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit", "sed", "do", "eiusmod", "tempor"};
+        return words[next() % 12];
+        
+    }
+    std::string sentence(std::size_t count) {
+        
+        std::string s = word();
+        for(std::size_t i = 1; i < count; ++i) s += ' ' + word();
+        return s;
+        
+    }
+    
+};
+
+// Generates a well-formed document of about size bytes
+inline std::string generate(Kind kind, std::size_t size) {
+    
+    Random random;
+    std::string data = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<corpus>\n";
+    while(data.size() < size) {
+        
+        switch(kind) {
+        
+        case Kind::AttributeHeavy: {
+            
+            data += "  <item";
+            for(std::size_t i = 0; i < 12; ++i)
+                data += " attr" + std::to_string(i) + "=\"" + random.word() + std::to_string(random.next()) + "\"";
+            data += "/>\n";
+            break;
+            
+        }
+        case Kind::TextHeavy: {
+            
+            data += "  <para>" + random.sentence(80 + random.next() % 80) + "</para>\n";
+            break;
+            
+        }
+        case Kind::DeepNesting: {
+            
+            const std::size_t depth = 256;
+            for(std::size_t i = 0; i < depth; ++i) data += "<level d=\"" + std::to_string(i) + "\">";
+            data += random.word();
+            for(std::size_t i = 0; i < depth; ++i) data += "</level>";
+            data += '\n';
+            break;
+            
+        }
+        case Kind::EntityHeavy: {
+            
+            data += "  <entry key=\"&lt;" + random.word() + "&gt; &amp; &quot;" + random.word() + "&quot;\">";
+            for(std::size_t i = 0; i < 8; ++i)
+                data += random.word() + " &amp; &lt;" + random.word() + "&gt; &#" + std::to_string(160 + random.next() % 96) + "; &#x" + "263A; ";
+            data += "</entry>\n";
+            break;
+            
+        }
+        case Kind::CDATAHeavy: {
+            
+            data += "  <script><![CDATA[if(a < b && c > d) { " + random.sentence(60) + " }]]></script>\n";
+            break;
+            
+        }
+        case Kind::FlatRecords: {
+            
+            data += "  <row><id>" + std::to_string(random.next()) + "</id><name>" + random.word() + "</name><value>"
+                + std::to_string(random.next() % 1000) + "</value><ok/></row>\n";
+            break;
+            
+        }
+            
+        }
+        
+    }
+    data += "</corpus>\n";
+    return data;
+
+}
+
+// Generates count records with attributes, entities and the note text in each,
+// and a comment before the value if comment is true
+inline std::string generateRecords(std::size_t count, const std::string& note, bool comment = false) {
+    
+    std::string data = "<?xml version=\"1.0\"?>\n<records>\n";
+    std::uint32_t seed = 1;
+    for(std::size_t i = 0; i < count; ++i) {
+        
+        seed = seed * 1103515245 + 12345;
+        data += "  <record id=\"" + std::to_string(i) + "\" type=\"" + (seed & 0x10000 ? "a" : "b&amp;c") + "\">\n";
+        data += "    <name>Record " + std::to_string(seed >> 16) + "</name>\n";
+        if(comment) data += "    <!-- <value> is in milliseconds -->\n";
+        data += "    <value unit=\"ms\">" + std::to_string(seed % 100000) + "</value>\n";
+        data += "    <note>" + note + "</note>\n";
+        data += "  </record>\n";
+        
+    }
+    data += "</records>\n";
+    return data;
+
+}
+
+// Generates count empty records with attributeCount attributes each
+inline std::string generateAttributes(std::size_t count, std::size_t attributeCount) {
+    
+    std::string data = "<records>\n";
+    for(std::size_t i = 0; i < count; ++i) {
+        
+        data += "  <record";
+        for(std::size_t j = 0; j < attributeCount; ++j)
+            data += " field" + std::to_string(j) + "=\"" + std::to_string(i * j) + "\"";
+        data += "/>\n";
+        
+    }
+    data += "</records>\n";
+    return data;
+
+}
+
+// Generates count items with a section of sectionSize base64 characters between
+// open and close in each
+inline std::string generateSections(const std::string& open, const std::string& close, std::size_t sectionSize, std::size_t count) {
+    
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string data = "<root>";
+    std::uint32_t seed = 1;
+    for(std::size_t i = 0; i < count; ++i) {
+        
+        data += "<item>" + open;
+        for(std::size_t j = 0; j < sectionSize; ++j) {
+            
+            seed = seed * 1103515245 + 12345;
+            data += table[(seed >> 16) & 63];
+            if(j % 76 == 75) data += '\n';
+            
+        }
+        data += close + "</item>";
+        
+    }
+    data += "</root>";
+    return data;
+
+}
+
+}
+
+namespace Bench {
+
+struct Result {
+    
+    double seconds;
+    std::size_t count;
+    
+    // MB/s of size bytes of source data
+    double getSpeed(std::size_t size) const { return size / seconds / 1048576; }
+    
+};
+
+// Runs f round times and keeps the fastest run with the count f returns
+template <typename F>
+Result measure(int round, F f) {
+    
+    Result best = {0, 0};
+    for(int i = 0; i < round; ++i) {
+        
+        auto begin = std::chrono::steady_clock::now();
+        std::size_t count = f();
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - begin).count();
+        if(!i || seconds < best.seconds) best = {seconds, count};
+        
+    }
+    return best;
+
+}
+// Like measure(round, f), but f gets a fresh copy of the data, since parsing
+// in place modifies it
+template <typename F>
+Result measure(const std::string& data, int round, F f) {
+    
+    Result best = {0, 0};
+    for(int i = 0; i < round; ++i) {
+        
+        std::vector<char> buffer(data.begin(), data.end());
+        auto begin = std::chrono::steady_clock::now();
+        std::size_t count = f(buffer);
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - begin).count();
+        if(!i || seconds < best.seconds) best = {seconds, count};
+        
+    }
+    return best;
+
+}
+
+}
+
+
+#endif
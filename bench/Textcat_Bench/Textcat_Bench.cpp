@@ -0,0 +1,179 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Cats/Corecat/Data/Stream.hpp"
+#include "Cats/Textcat/XML.hpp"
+
+#include "../Bench.hpp"
+
+using namespace Cats::Corecat;
+using namespace Cats::Textcat;
+
+// Counts every event, so that none of them can be optimized away
+class Handler : public XMLHandlerBase {
+    
+public:
+    
+    std::size_t count = 0;
+    
+public:
+    
+    void startDocument() { ++count; }
+    void endDocument() { ++count; }
+    void startElement(StringView8 /*name*/) { ++count; }
+    void endElement(StringView8 /*name*/) { ++count; }
+    void endAttributes(bool /*empty*/) { ++count; }
+    void attribute(StringView8 /*name*/, StringView8 /*value*/) { ++count; }
+    void text(StringView8 /*value*/) { ++count; }
+    void cdata(StringView8 /*value*/) { ++count; }
+    void comment(StringView8 /*value*/) { ++count; }
+    void processingInstruction(StringView8 /*name*/, StringView8 /*value*/) { ++count; }
+    
+};
+
+void report(const char* corpus, const char* name, std::size_t size, Bench::Result result) {
+    
+    std::cout << std::left << std::setw(10) << corpus << std::setw(40) << name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(10) << result.getSpeed(size) << " MB/s"
+        << std::setw(10) << result.count / result.seconds / 1000000 << " Mevents/s\n";
+
+}
+
+template <XMLParser::Flag F>
+void benchParser(const char* corpus, const char* name, const std::string& data, int round) {
+    
+    report(corpus, name, data.size(), Bench::measure(data, round, [&](std::vector<char>& buffer) {
+        
+        XMLParser parser;
+        Handler handler;
+        parser.parse<F>(buffer.data(), buffer.size(), handler);
+        return handler.count;
+        
+    }));
+
+}
+
+int main(int argc, char** argv) {
+    
+    try {
+        
+        using Flag = XMLParser::Flag;
+        
+        // Usage: Textcat_Bench [size in MiB] [round]
+        const std::size_t size = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16) << 20;
+        const int round = argc > 2 ? std::atoi(argv[2]) : 5;
+        
+        for(auto kind : Corpus::kinds) {
+            
+            const char* corpus = Corpus::getName(kind);
+            const std::string data = Corpus::generate(kind, size);
+            
+            benchParser<Flag::None>(corpus, "XMLParser::parse None", data, round);
+            benchParser<Flag::TrimSpace>(corpus, "XMLParser::parse TrimSpace", data, round);
+            benchParser<Flag::EntityTranslation>(corpus, "XMLParser::parse EntityTranslation", data, round);
+            benchParser<Flag::Default>(corpus, "XMLParser::parse Default", data, round);
+            benchParser<Flag::NormalizeSpace | Flag::EntityTranslation>(corpus, "XMLParser::parse NormalizeSpace", data, round);
+            benchParser<Flag::Default | Flag::ClosingTagValidate>(corpus, "XMLParser::parse ClosingTagValidate", data, round);
+            benchParser<Flag::Default | Flag::NonDestructive>(corpus, "XMLParser::parse NonDestructive", data, round);
+            
+            XMLDocument document;
+            Handler counter;
+            document.parse<>(data.data(), data.size());
+            document.visit(counter);
+            report(corpus, "XMLDocument::parse", data.size(), Bench::measure(data, round, [&](std::vector<char>& buffer) {
+                
+                document.parse<>(buffer.data(), buffer.size());
+                return counter.count;
+                
+            }));
+            
+            // The document keeps referring to the data from here on
+            document.parse<>(data.data(), data.size());
+            report(corpus, "XMLDocument::visit", data.size(), Bench::measure(round, [&]() {
+                
+                Handler handler;
+                document.visit(handler);
+                return handler.count;
+                
+            }));
+            XMLFlatDocument flatDocument;
+            report(corpus, "XMLFlatDocument::parse", data.size(), Bench::measure(data, round, [&](std::vector<char>& buffer) {
+                
+                flatDocument.parse<>(buffer.data(), buffer.size());
+                return counter.count;
+                
+            }));
+            flatDocument.parse<>(data.data(), data.size());
+            report(corpus, "XMLFlatDocument::visit", data.size(), Bench::measure(round, [&]() {
+                
+                Handler handler;
+                flatDocument.visit(handler);
+                return handler.count;
+                
+            }));
+            std::ostringstream stream;
+            report(corpus, "XMLSerializer", data.size(), Bench::measure(round, [&]() {
+                
+                stream.str(std::string());
+                auto wrapper = createWrapperOutputStream(stream);
+                XMLSerializer serializer(wrapper);
+                document.visit(serializer);
+                return counter.count;
+                
+            }));
+            std::string output;
+            report(corpus, "XMLSerializer to std::string", data.size(), Bench::measure(round, [&]() {
+                
+                output.clear();
+                BasicXMLSerializer<XMLStringSink> serializer(output);
+                document.visit(serializer);
+                return counter.count;
+                
+            }));
+            // Only builds the list, the names and values stay in the data
+            BasicXMLSerializer<XMLIovecSink> iovecSerializer{XMLIovecSink()};
+            report(corpus, "XMLSerializer to XMLIovecSink", data.size(), Bench::measure(round, [&]() {
+                
+                iovecSerializer.getSink().clear();
+                document.visit(iovecSerializer);
+                return counter.count;
+                
+            }));
+            
+        }
+        
+    } catch(std::exception& e) { std::cerr << e.what() << std::endl; return 1; }
+    
+    return 0;
+
+}
@@ -0,0 +1,349 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// Parses the corpora of Textcat_Bench with Textcat and, when they were found
+// at configure time, with RapidXml, pugixml and libxml2. Every parser runs in
+// a process of its own so that its peak RSS can be told apart.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#   include <sys/resource.h>
+#endif
+
+#if defined(TEXTCAT_COMPARE_RAPIDXML)
+#   include <rapidxml.hpp>
+#endif
+#if defined(TEXTCAT_COMPARE_PUGIXML)
+#   include <pugixml.hpp>
+#endif
+#if defined(TEXTCAT_COMPARE_LIBXML2)
+#   include <libxml/parser.h>
+#   include <libxml/tree.h>
+#endif
+
+#include "Cats/Textcat/XML.hpp"
+
+#include "../Bench.hpp"
+
+using namespace Cats::Corecat;
+using namespace Cats::Textcat;
+
+// Allocations made by operator new and by the C allocator hooks below
+static std::atomic<std::size_t> allocationCount(0);
+
+void* allocate(std::size_t size) {
+    
+    ++allocationCount;
+    if(void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+
+}
+void deallocate(void* p) noexcept { std::free(p); }
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void operator delete(void* p) noexcept { deallocate(p); }
+void operator delete[](void* p) noexcept { deallocate(p); }
+void operator delete(void* p, std::size_t) noexcept { deallocate(p); }
+void operator delete[](void* p, std::size_t) noexcept { deallocate(p); }
+
+void* countingMalloc(std::size_t size) { ++allocationCount; return std::malloc(size); }
+void* countingRealloc(void* p, std::size_t size) { ++allocationCount; return std::realloc(p, size); }
+char* countingStrdup(const char* s) {
+    
+    ++allocationCount;
+    const std::size_t size = std::strlen(s) + 1;
+    auto p = static_cast<char*>(std::malloc(size));
+    if(p) std::memcpy(p, s, size);
+    return p;
+
+}
+
+class Handler : public XMLHandlerBase {
+    
+public:
+    
+    std::size_t count = 0;
+    
+public:
+    
+    void startElement(StringView8 /*name*/) { ++count; }
+    void attribute(StringView8 /*name*/, StringView8 /*value*/) { ++count; }
+    void text(StringView8 /*value*/) { ++count; }
+    void cdata(StringView8 /*value*/) { ++count; }
+    
+};
+
+// Parses a fresh copy of the data in each round; parse() returns false if
+// the library rejected the data
+class Parser {
+    
+public:
+    
+    virtual ~Parser() {}
+    virtual bool parse(std::vector<char>& buffer) = 0;
+    // Frees what the last parse() built, outside of the timing
+    virtual void release() {}
+    
+};
+
+class TextcatDOMParser : public Parser {
+    
+private:
+    
+    std::unique_ptr<XMLDocument> document;
+    
+public:
+    
+    bool parse(std::vector<char>& buffer) override {
+        
+        document.reset(new XMLDocument);
+        document->parse<>(buffer.data(), buffer.size() - 1);
+        return true;
+        
+    }
+    void release() override { document.reset(); }
+    
+};
+
+class TextcatSAXParser : public Parser {
+    
+public:
+    
+    bool parse(std::vector<char>& buffer) override {
+        
+        XMLParser parser;
+        Handler handler;
+        parser.parse<>(buffer.data(), buffer.size() - 1, handler);
+        return handler.count != 0;
+        
+    }
+    
+};
+
+#if defined(TEXTCAT_COMPARE_RAPIDXML)
+class RapidXmlParser : public Parser {
+    
+private:
+    
+    std::unique_ptr<rapidxml::xml_document<>> document;
+    
+public:
+    
+    bool parse(std::vector<char>& buffer) override {
+        
+        // Trimmed and with entities translated, like XMLParser::Flag::Default
+        document.reset(new rapidxml::xml_document<>);
+        document->parse<rapidxml::parse_trim_whitespace>(buffer.data());
+        return document->first_node() != nullptr;
+        
+    }
+    void release() override { document.reset(); }
+    
+};
+#endif
+
+#if defined(TEXTCAT_COMPARE_PUGIXML)
+class PugixmlParser : public Parser {
+    
+private:
+    
+    std::unique_ptr<pugi::xml_document> document;
+    
+public:
+    
+    bool parse(std::vector<char>& buffer) override {
+        
+        document.reset(new pugi::xml_document);
+        return document->load_buffer_inplace(buffer.data(), buffer.size() - 1, pugi::parse_default | pugi::parse_trim_pcdata);
+        
+    }
+    void release() override { document.reset(); }
+    
+};
+#endif
+
+#if defined(TEXTCAT_COMPARE_LIBXML2)
+class LibXml2Parser : public Parser {
+    
+private:
+    
+    xmlDocPtr document = nullptr;
+    
+public:
+    
+    bool parse(std::vector<char>& buffer) override {
+        
+        document = xmlReadMemory(buffer.data(), static_cast<int>(buffer.size() - 1), "corpus.xml", nullptr,
+            XML_PARSE_NONET | XML_PARSE_HUGE | XML_PARSE_NOBLANKS);
+        return document != nullptr;
+        
+    }
+    void release() override { if(document) xmlFreeDoc(document); document = nullptr; }
+    
+};
+#endif
+
+std::unique_ptr<Parser> createParser(const std::string& name) {
+    
+    if(name == "textcat-dom") return std::unique_ptr<Parser>(new TextcatDOMParser);
+    if(name == "textcat-sax") return std::unique_ptr<Parser>(new TextcatSAXParser);
+#if defined(TEXTCAT_COMPARE_RAPIDXML)
+    if(name == "rapidxml") return std::unique_ptr<Parser>(new RapidXmlParser);
+#endif
+#if defined(TEXTCAT_COMPARE_PUGIXML)
+    if(name == "pugixml") {
+        
+        pugi::set_memory_management_functions(countingMalloc, std::free);
+        return std::unique_ptr<Parser>(new PugixmlParser);
+        
+    }
+#endif
+#if defined(TEXTCAT_COMPARE_LIBXML2)
+    if(name == "libxml2") {
+        
+        xmlMemSetup(std::free, countingMalloc, countingRealloc, countingStrdup);
+        xmlInitParser();
+        return std::unique_ptr<Parser>(new LibXml2Parser);
+        
+    }
+#endif
+    return nullptr;
+
+}
+
+const char* const parserNames[] = {
+    
+    "textcat-dom",
+    "textcat-sax",
+#if defined(TEXTCAT_COMPARE_RAPIDXML)
+    "rapidxml",
+#endif
+#if defined(TEXTCAT_COMPARE_PUGIXML)
+    "pugixml",
+#endif
+#if defined(TEXTCAT_COMPARE_LIBXML2)
+    "libxml2",
+#endif
+    
+};
+
+// Peak resident set size of this process in MiB, or a negative value if it
+// is not known on this platform
+double getPeakRSS() {
+
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage)) return -1;
+#   if defined(__APPLE__)
+    return usage.ru_maxrss / 1048576.0;
+#   else
+    return usage.ru_maxrss / 1024.0;
+#   endif
+#else
+    return -1;
+#endif
+
+}
+
+// Runs one parser on one corpus and prints a line of results
+int run(const std::string& name, Corpus::Kind kind, std::size_t size, int round) {
+    
+    auto parser = createParser(name);
+    if(!parser) { std::cerr << "Unknown parser " << name << std::endl; return 1; }
+    const std::string data = Corpus::generate(kind, size);
+    double best = 0;
+    std::size_t allocations = 0;
+    for(int i = 0; i < round; ++i) {
+        
+        std::vector<char> buffer(data.begin(), data.end());
+        buffer.push_back(0);
+        allocationCount = 0;
+        auto begin = std::chrono::steady_clock::now();
+        const bool ok = parser->parse(buffer);
+        auto end = std::chrono::steady_clock::now();
+        allocations = allocationCount;
+        parser->release();
+        if(!ok) { std::cerr << name << " failed to parse " << Corpus::getName(kind) << std::endl; return 1; }
+        double speed = data.size() / std::chrono::duration<double>(end - begin).count() / 1048576;
+        if(speed > best) best = speed;
+        
+    }
+    const double peak = getPeakRSS();
+    std::cout << std::left << std::setw(10) << Corpus::getName(kind) << std::setw(14) << name << std::right << std::fixed
+        << std::setprecision(1) << std::setw(10) << best << " MB/s" << std::setw(12) << allocations << " allocs";
+    if(peak >= 0) std::cout << std::setw(10) << peak << " MiB peak RSS";
+    std::cout << std::endl;
+    return 0;
+
+}
+
+int main(int argc, char** argv) {
+    
+    try {
+        
+        // Usage: Textcat_Compare [size in MiB] [round]
+        // Internally: Textcat_Compare --run <parser> <corpus> <size in MiB> <round>
+        if(argc == 6 && !std::strcmp(argv[1], "--run")) {
+            
+            for(auto kind : Corpus::kinds)
+                if(!std::strcmp(argv[3], Corpus::getName(kind)))
+                    return run(argv[2], kind, std::strtoul(argv[4], nullptr, 10) << 20, std::atoi(argv[5]));
+            std::cerr << "Unknown corpus " << argv[3] << std::endl;
+            return 1;
+            
+        }
+        
+        const std::string size = argc > 1 ? argv[1] : "16";
+        const std::string round = argc > 2 ? argv[2] : "5";
+        std::cout << "Corpus size " << size << " MiB; the peak RSS includes two copies of the corpus\n";
+        int result = 0;
+        for(auto kind : Corpus::kinds)
+            for(auto name : parserNames) {
+                
+                std::ostringstream command;
+                command << '"' << argv[0] << "\" --run " << name << ' ' << Corpus::getName(kind) << ' ' << size << ' ' << round;
+                std::cout.flush();
+                if(std::system(command.str().c_str())) result = 1;
+                
+            }
+        return result;
+        
+    } catch(std::exception& e) { std::cerr << e.what() << std::endl; return 1; }
+
+}
@@ -0,0 +1,119 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Cats/Textcat/XML.hpp"
+
+#include "../Bench.hpp"
+
+using namespace Cats::Corecat;
+using namespace Cats::Textcat;
+
+XMLAttribute* scan(XMLElement& element, StringView8 name) {
+    
+    for(auto& attr : element.attribute()) {
+        
+        auto attrName = attr.getName();
+        if(attrName.getLength() == name.getLength() && !std::memcmp(attrName.getData(), name.getData(), name.getLength())) return &attr;
+        
+    }
+    return nullptr;
+
+}
+
+// Returns the time of a lookup in nanoseconds
+template <typename F>
+double measure(XMLDocument& document, const std::vector<std::string>& names, int round, std::size_t& sum, F f) {
+    
+    auto result = Bench::measure(round, [&]() {
+        
+        std::size_t count = 0;
+        sum = 0;
+        for(auto& node : document.getRootElement().child()) {
+            
+            if(node.getType() != XMLNodeType::Element) continue;
+            for(auto& name : names) sum += f(node.asElement(), StringView8(name.data(), name.size()))->getValue().getLength();
+            count += names.size();
+            
+        }
+        return count;
+        
+    });
+    return result.seconds * 1e9 / result.count;
+
+}
+
+int main() {
+    
+    try {
+        
+        const int round = 10;
+        
+        for(std::size_t attributeCount : {4, 12, 40, 80}) {
+            
+            auto data = Corpus::generateAttributes(20000, attributeCount);
+            XMLAtomTable table;
+            XMLDocument document;
+            document.setAtomTable(&table);
+            document.parse<>(&data[0], data.size());
+            std::vector<std::string> names;
+            for(std::size_t i = 0; i < 15; ++i) names.push_back("field" + std::to_string(i * 7 % attributeCount));
+            std::size_t expected = 0, result = 0, atomResult = 0;
+            
+            double linear = measure(document, names, round, expected, scan);
+            double indexed = measure(document, names, round, result, [](XMLElement& element, StringView8 name) {
+                
+                return element.findAttribute(name);
+                
+            });
+            // The atoms of the names are looked up once, as a query would
+            std::vector<XMLAtom> atoms;
+            for(auto& name : names) atoms.push_back(table.find(StringView8(name.data(), name.size())));
+            std::size_t next = 0;
+            double atom = measure(document, names, round, atomResult, [&](XMLElement& element, StringView8 /*name*/) {
+                
+                return element.findAttribute(atoms[next++ % atoms.size()]);
+                
+            });
+            if(expected != result || expected != atomResult) throw std::runtime_error("Results differ");
+            
+            std::cout << attributeCount << " attributes:\n";
+            std::cout << "  Scan:            " << linear << " ns/lookup\n";
+            std::cout << "  findAttribute:   " << indexed << " ns/lookup\n";
+            std::cout << "  Atoms:           " << atom << " ns/lookup\n";
+            
+        }
+        
+    } catch(std::exception& e) { std::cerr << e.what() << std::endl; return 1; }
+    
+    return 0;
+
+}
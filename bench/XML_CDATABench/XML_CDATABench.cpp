@@ -0,0 +1,71 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Cats/Textcat/XML.hpp"
+
+#include "../Bench.hpp"
+
+using namespace Cats::Corecat;
+using namespace Cats::Textcat;
+
+double measure(const std::string& data, int round) {
+    
+    std::vector<char> buffer(data.begin(), data.end());
+    buffer.push_back(0);
+    // CDATA sections, comments and processing instructions are not modified
+    // by the parser, so the buffer can be reused.
+    return Bench::measure(round, [&]() {
+        
+        XMLParser parser;
+        XMLHandlerBase handler;
+        parser.parse<>(buffer.data(), handler);
+        return std::size_t(0);
+        
+    }).getSpeed(data.size());
+
+}
+
+int main() {
+    
+    try {
+        
+        const std::size_t sectionSize = 4 * 1048576;
+        const std::size_t count = 16;
+        const int round = 10;
+        
+        std::cout << "CDATA:                  " << measure(Corpus::generateSections("<![CDATA[", "]]>", sectionSize, count), round) << " MB/s\n";
+        std::cout << "Comment:                " << measure(Corpus::generateSections("<!--", "-->", sectionSize, count), round) << " MB/s\n";
+        std::cout << "Processing instruction: " << measure(Corpus::generateSections("<?pi ", "?>", sectionSize, count), round) << " MB/s\n";
+        
+    } catch(std::exception& e) { std::cerr << e.what() << std::endl; return 1; }
+    
+    return 0;
+
+}
@@ -0,0 +1,125 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Cats/Textcat/XML.hpp"
+
+#include "../Bench.hpp"
+
+using namespace Cats::Corecat;
+using namespace Cats::Textcat;
+
+class Handler : public XMLHandlerBase {
+    
+public:
+    
+    std::size_t count = 0;
+    
+public:
+    
+    void startElement(StringView8 /*name*/) { ++count; }
+    void text(StringView8 /*value*/) { ++count; }
+    
+};
+// Counts like Handler, but only inside the children of the root element,
+// which is what XMLRecordParser parses
+class RecordHandler : public XMLHandlerBase {
+    
+public:
+    
+    std::size_t count = 0;
+    std::size_t depth = 0;
+    
+public:
+    
+    void startElement(StringView8 /*name*/) { if(depth++) ++count; }
+    void endElement(StringView8 /*name*/) { --depth; }
+    void endAttributes(bool empty) { if(empty) --depth; }
+    void text(StringView8 /*value*/) { if(depth > 1) ++count; }
+    
+};
+
+int main() {
+    
+    try {
+        
+        const std::size_t count = 1000000;
+        const int round = 5;
+        
+        auto data = Corpus::generateRecords(count, "<![CDATA[<b>Raw</b> markup]]> and text with &lt;entities&gt;", true);
+        std::size_t expected = 0;
+        RecordHandler recordHandler;
+        XMLParser().parse<>(static_cast<const char*>(data.data()), data.size(), recordHandler);
+        const std::size_t expectedRecord = recordHandler.count;
+        
+        std::cout << "Sequential:  " << Bench::measure(round, [&]() {
+            
+            XMLParser parser;
+            Handler handler;
+            parser.parse<>(static_cast<const char*>(data.data()), data.size(), handler);
+            expected = handler.count;
+            return handler.count;
+            
+        }).getSpeed(data.size()) << " MB/s\n";
+        const std::size_t maxThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+        for(std::size_t threadCount = 1; ; threadCount *= 2) {
+            
+            if(threadCount > maxThreadCount) threadCount = maxThreadCount;
+            XMLParallelParser parser(threadCount);
+            std::cout << threadCount << " threads: " << std::string(threadCount < 10 ? 3 : 2, ' ') << Bench::measure(round, [&]() {
+                
+                Handler handler;
+                parser.parse<>(data.data(), data.size(), handler);
+                if(handler.count != expected) throw std::runtime_error("Results differ");
+                return handler.count;
+                
+            }).getSpeed(data.size()) << " MB/s\n";
+            XMLRecordParser recordParser(threadCount);
+            std::cout << threadCount << " threads (records): " << std::string(threadCount < 10 ? 3 : 2, ' ') << Bench::measure(round, [&]() {
+                
+                std::vector<Handler> handlers(threadCount);
+                recordParser.parse<>(data.data(), data.size(), handlers);
+                std::size_t recordCount = 0;
+                for(auto& handler : handlers) recordCount += handler.count;
+                if(recordCount != expectedRecord) throw std::runtime_error("Results differ");
+                return recordCount;
+                
+            }).getSpeed(data.size()) << " MB/s\n";
+            if(threadCount == maxThreadCount) break;
+            
+        }
+        
+    } catch(std::exception& e) { std::cerr << e.what() << std::endl; return 1; }
+    
+    return 0;
+
+}
@@ -0,0 +1,109 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Cats/Textcat/XML.hpp"
+
+#include "../Bench.hpp"
+
+using namespace Cats::Corecat;
+using namespace Cats::Textcat;
+
+class Handler : public XMLHandlerBase {
+    
+public:
+    
+    std::size_t count = 0;
+    std::size_t size = 0;
+    
+public:
+    
+    void startElement(StringView8 name) { ++count; size += name.getLength(); }
+    void attribute(StringView8 name, StringView8 value) { size += name.getLength() + value.getLength(); }
+    void text(StringView8 value) { ++count; size += value.getLength(); }
+    
+};
+
+int main() {
+    
+    try {
+        
+        const std::size_t count = 400000;
+        const int round = 10;
+        
+        auto data = Corpus::generateRecords(count, "Text with &lt;entities&gt; and some more words in it");
+        std::size_t saxCount = 0, readerCount = 0;
+        
+        double sax = Bench::measure(data, round, [&](std::vector<char>& buffer) {
+            
+            XMLParser parser;
+            Handler handler;
+            parser.parse<>(buffer.data(), buffer.size(), handler);
+            saxCount = handler.count + handler.size;
+            return saxCount;
+            
+        }).getSpeed(data.size());
+        double reader = Bench::measure(data, round, [&](std::vector<char>& buffer) {
+            
+            XMLReader<> reader(buffer.data(), buffer.size());
+            std::size_t count = 0, size = 0;
+            while(true) {
+                
+                auto type = reader.next();
+                if(type == XMLTokenType::EndDocument) break;
+                else if(type == XMLTokenType::StartElement) {
+                    
+                    ++count;
+                    size += reader.getName().getLength();
+                    for(std::size_t i = 0; i < reader.getAttributeCount(); ++i)
+                        size += reader.getAttributeName(i).getLength() + reader.getAttributeValue(i).getLength();
+                    
+                } else if(type == XMLTokenType::Text) {
+                    
+                    ++count;
+                    size += reader.getValue().getLength();
+                    
+                }
+                
+            }
+            readerCount = count + size;
+            return readerCount;
+            
+        }).getSpeed(data.size());
+        if(saxCount != readerCount) throw std::runtime_error("Results differ");
+        
+        std::cout << "SAX:    " << sax << " MB/s\n";
+        std::cout << "Reader: " << reader << " MB/s\n";
+        
+    } catch(std::exception& e) { std::cerr << e.what() << std::endl; return 1; }
+    
+    return 0;
+
+}
@@ -0,0 +1,105 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "Cats/Textcat/XML.hpp"
+
+#include "../Bench.hpp"
+
+using namespace Cats::Corecat;
+using namespace Cats::Textcat;
+
+class Handler : public XMLHandlerBase {
+    
+public:
+    
+    std::size_t count = 0;
+    std::size_t size = 0;
+    
+public:
+    
+    void startElement(StringView8 name) { ++count; size += name.getLength(); }
+    void attribute(StringView8 name, StringView8 value) { size += name.getLength() + value.getLength(); }
+    void text(StringView8 value) { ++count; size += value.getLength(); }
+    
+};
+
+int main() {
+    
+    try {
+        
+        const int round = 10;
+        
+        for(std::size_t textLength : {16, 256}) {
+            
+            auto data = Corpus::generateRecords(100000, "Text with &lt;entities&gt; and " + std::string(textLength, 'w'));
+            std::size_t expected = 0, result = 0;
+            XMLParser parser;
+            XMLStructuralIndex index;
+            
+            double direct = Bench::measure(round, [&]() {
+                
+                Handler handler;
+                parser.parse<>(static_cast<const char*>(data.data()), data.size(), handler);
+                expected = handler.count + handler.size;
+                return expected;
+                
+            }).getSpeed(data.size());
+            double build = Bench::measure(round, [&]() { index.build(data.data(), data.size()); return std::size_t(0); }).getSpeed(data.size());
+            double walk = Bench::measure(round, [&]() {
+                
+                Handler handler;
+                index.parse<>(parser, handler);
+                result = handler.count + handler.size;
+                return result;
+                
+            }).getSpeed(data.size());
+            double both = Bench::measure(round, [&]() {
+                
+                XMLStructuralIndex index(data.data(), data.size());
+                Handler handler;
+                index.parse<>(parser, handler);
+                return handler.count;
+                
+            }).getSpeed(data.size());
+            if(expected != result) throw std::runtime_error("Results differ");
+            
+            std::cout << "Text length " << textLength << ":\n";
+            std::cout << "  Direct:          " << direct << " MB/s\n";
+            std::cout << "  Stage 1:         " << build << " MB/s\n";
+            std::cout << "  Stage 2:         " << walk << " MB/s\n";
+            std::cout << "  Stage 1 + 2:     " << both << " MB/s\n";
+            
+        }
+        
+    } catch(std::exception& e) { std::cerr << e.what() << std::endl; return 1; }
+    
+    return 0;
+
+}
@@ -40,9 +40,8 @@ std::vector<char> readFile(const char* path) {
     is.seekg(0, std::ios::end);
     std::size_t size = static_cast<std::size_t>(is.tellg());
     is.seekg(0);
-    std::vector<char> data(size + 1);
+    std::vector<char> data(size);
     is.read(data.data(), size);
-    data[size] = 0;
     return data;
     
 }
@@ -57,7 +56,7 @@ int main(int argc, char** argv) {
             
             auto data = readFile(argv[i]);
             XMLDocument document;
-            document.parse<>(data.data());
+            document.parse<>(data.data(), data.size());
             std::cout << document << std::endl;
             
         }
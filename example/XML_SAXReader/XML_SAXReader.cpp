@@ -99,9 +99,8 @@ std::vector<char> readFile(const char* path) {
     is.seekg(0, std::ios::end);
     std::size_t size = static_cast<std::size_t>(is.tellg());
     is.seekg(0);
-    std::vector<char> data(size + 1);
+    std::vector<char> data(size);
     is.read(data.data(), size);
-    data[size] = 0;
     return data;
     
 }
@@ -117,7 +116,7 @@ int main(int argc, char** argv) {
             auto data = readFile(argv[i]);
             XMLParser parser;
             Handler handler;
-            parser.parse<>(data.data(), handler);
+            parser.parse<>(data.data(), data.size(), handler);
             
         }
         
@@ -28,10 +28,19 @@
 #define CATS_TEXTCAT_XML_HPP
 
 
+#include "XML/AtomTable.hpp"
 #include "XML/Document.hpp"
+#include "XML/FlatDocument.hpp"
 #include "XML/Handler.hpp"
+#include "XML/ParallelParser.hpp"
+#include "XML/ParallelSerializer.hpp"
 #include "XML/Parser.hpp"
+#include "XML/PushParser.hpp"
+#include "XML/Reader.hpp"
+#include "XML/RecordParser.hpp"
 #include "XML/Serializer.hpp"
+#include "XML/Sink.hpp"
+#include "XML/StructuralIndex.hpp"
 
 
 #endif
@@ -0,0 +1,231 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CATS_TEXTCAT_XML_ATOMTABLE_HPP
+#define CATS_TEXTCAT_XML_ATOMTABLE_HPP
+
+
+#include <cstdint>
+#include <cstring>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Cats/Corecat/Text/String.hpp"
+
+
+namespace Cats {
+namespace Textcat{
+inline namespace XML {
+
+// Number of a name in an XMLAtomTable. Atoms start at 1; 0 stands for no
+// atom.
+using XMLAtom = std::uint32_t;
+
+namespace Impl {
+
+// Mixes the name into the hash a word at a time with a multiply and an
+// xorshift. The last word overlaps the one before it, so nothing past the
+// end is read.
+inline std::uint32_t hashName(Corecat::StringView8 name) {
+    
+    const char* p = name.getData();
+    const std::size_t length = name.getLength();
+    std::uint64_t h = length * 0x9E3779B97F4A7C15u;
+    auto mix = [&](std::uint64_t word) { h = (h ^ word) * 0xFF51AFD7ED558CCDu; h ^= h >> 32; };
+    auto load = [](const char* q, std::size_t size) { std::uint64_t word = 0; std::memcpy(&word, q, size); return word; };
+    if(length >= 8) {
+        
+        for(std::size_t i = 0; i + 8 < length; i += 8) mix(load(p + i, 8));
+        mix(load(p + length - 8, 8));
+        
+    } else if(length >= 4) mix(load(p, 4) | load(p + length - 4, 4) << 32);
+    else if(length) {
+        
+        mix(static_cast<unsigned char>(p[0]) | static_cast<unsigned char>(p[length / 2]) << 8 | static_cast<unsigned char>(p[length - 1]) << 16);
+        
+    }
+    return static_cast<std::uint32_t>(h);
+
+}
+inline bool equalName(Corecat::StringView8 a, Corecat::StringView8 b) {
+    
+    return a.getLength() == b.getLength() && !std::memcmp(a.getData(), b.getData(), a.getLength());
+
+}
+// Orders names by their bytes, then by length
+inline int compareName(Corecat::StringView8 a, Corecat::StringView8 b) {
+    
+    const std::size_t length = a.getLength() < b.getLength() ? a.getLength() : b.getLength();
+    if(const int result = length ? std::memcmp(a.getData(), b.getData(), length) : 0) return result;
+    return a.getLength() < b.getLength() ? -1 : a.getLength() > b.getLength();
+
+}
+
+}
+
+// Gives each distinct name a number, so that names can be compared as
+// integers. The table keeps copies of the names, so it can outlive the
+// documents that use it. A table made thread-safe can be shared by documents
+// parsed on several threads.
+class XMLAtomTable {
+    
+private:
+    
+    using StringView8 = Corecat::StringView8;
+    
+    struct Slot {
+        
+        std::uint32_t hash;
+        XMLAtom atom;
+        
+    };
+    
+public:
+    
+    static constexpr std::size_t BlockSize = 4096;
+    
+private:
+    
+    bool threadSafe;
+    mutable std::mutex mutex;
+    // Hash table with open addressing, atom 0 in empty slots
+    std::vector<Slot> slots;
+    // Names by atom, copied into blocks
+    std::vector<StringView8> names;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* current;
+    std::size_t size;
+    
+private:
+    
+    // Returns the index of the slot of name, or of the empty slot where it
+    // would go
+    std::size_t findSlot(StringView8 name, std::uint32_t h) const {
+        
+        const std::size_t mask = slots.size() - 1;
+        std::size_t i = h & mask;
+        while(slots[i].atom && !(slots[i].hash == h && Impl::equalName(names[slots[i].atom], name))) i = (i + 1) & mask;
+        return i;
+        
+    }
+    StringView8 copy(StringView8 name) {
+        
+        const std::size_t length = name.getLength();
+        char* data;
+        if(length > BlockSize / 4) {
+            
+            blocks.emplace_back(new char[length]);
+            data = blocks.back().get();
+            
+        } else {
+            
+            if(BlockSize - size < length) {
+                
+                blocks.emplace_back(new char[BlockSize]);
+                current = blocks.back().get();
+                size = 0;
+                
+            }
+            data = current + size;
+            size += length;
+            
+        }
+        std::memcpy(data, name.getData(), length);
+        return StringView8(data, length);
+        
+    }
+    void grow() {
+        
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        const std::size_t mask = slots.size() - 1;
+        for(auto& slot : old) {
+            
+            if(!slot.atom) continue;
+            std::size_t i = slot.hash & mask;
+            while(slots[i].atom) i = (i + 1) & mask;
+            slots[i] = slot;
+            
+        }
+        
+    }
+    
+public:
+    
+    XMLAtomTable(bool threadSafe_ = false) :
+        threadSafe(threadSafe_), mutex(), slots(64), names(1), blocks(), current(), size(BlockSize) {}
+    XMLAtomTable(const XMLAtomTable& src) = delete;
+    
+    // Returns the atom of name, adding name if it is new
+    XMLAtom intern(StringView8 name) {
+        
+        std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+        if(threadSafe) lock.lock();
+        const auto h = Impl::hashName(name);
+        auto& slot = slots[findSlot(name, h)];
+        if(slot.atom) return slot.atom;
+        const auto atom = static_cast<XMLAtom>(names.size());
+        names.push_back(copy(name));
+        slot = {h, atom};
+        if(names.size() * 2 > slots.size()) grow();
+        return atom;
+        
+    }
+    // Returns the atom of name, or 0 if it has none
+    XMLAtom find(StringView8 name) const {
+        
+        std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+        if(threadSafe) lock.lock();
+        return slots[findSlot(name, Impl::hashName(name))].atom;
+        
+    }
+    StringView8 getName(XMLAtom atom) const {
+        
+        std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+        if(threadSafe) lock.lock();
+        return names[atom];
+        
+    }
+    // Number of atoms
+    std::size_t getSize() const {
+        
+        std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+        if(threadSafe) lock.lock();
+        return names.size() - 1;
+        
+    }
+    bool isThreadSafe() const { return threadSafe; }
+    
+};
+
+}
+}
+}
+
+
+#endif
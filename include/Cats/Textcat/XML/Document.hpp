@@ -29,16 +29,20 @@
 
 
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 
+#include <algorithm>
 #include <new>
 #include <iostream>
+#include <vector>
 
 #include "Cats/Corecat/Data/Allocator/FastAllocator.hpp"
 #include "Cats/Corecat/Data/Stream.hpp"
 #include "Cats/Corecat/Text/String.hpp"
 #include "Cats/Corecat/Util/Exception.hpp"
 
+#include "AtomTable.hpp"
 #include "Handler.hpp"
 #include "Parser.hpp"
 #include "Serializer.hpp"
@@ -127,6 +131,7 @@ public:
         child.prev = pPrev;
         child.next = &ref;
         if(pPrev) pPrev->next = &child;
+        else first = &child;
         ref.prev = &child;
         child.parent = ref.parent;
         return child;
@@ -139,7 +144,7 @@ public:
         auto pNext = child.next;
         if(pPrev) pPrev->next = pNext;
         else first = pNext;
-        if(pNext) pNext->next = pPrev;
+        if(pNext) pNext->prev = pPrev;
         else last = pPrev;
         child.prev = nullptr;
         child.next = nullptr;
@@ -147,6 +152,9 @@ public:
         return child;
         
     }
+    // Forgets all elements without unlinking them, for when they are freed
+    // together
+    void clear() { first = last = nullptr; }
     
     T& getFirst() { return *first; }
     T& getLast() { return *last; }
@@ -180,16 +188,44 @@ enum class XMLNodeType : uint16_t {
     
 };
 
+namespace Impl {
+
+// Arrays of the children of a node, built by XMLDocument::buildChildIndex()
+struct ChildIndex {
+    
+    std::size_t count;
+    std::size_t elementCount;
+    XMLElement* firstElement;
+    
+    // The children in order, followed by the elements among them sorted by
+    // name
+    XMLNode** getNodes() { return reinterpret_cast<XMLNode**>(this + 1); }
+    XMLElement** getElements() { return reinterpret_cast<XMLElement**>(getNodes() + count); }
+    
+};
+
+}
+
 class XMLNode : public Impl::List<XMLNode>::ListElement {
     
+private:
+    
+    using StringView8 = Corecat::StringView8;
+    
+private:
+    
+    friend class XMLDocument;
+    
 private:
     
     const XMLNodeType type;
     Impl::List<XMLNode> listChild;
+    // Dropped when the children change
+    Impl::ChildIndex* childIndex;
     
 public:
     
-    XMLNode(XMLNodeType type_) : Impl::List<XMLNode>::ListElement(), type(type_), listChild() {}
+    XMLNode(XMLNodeType type_) : Impl::List<XMLNode>::ListElement(), type(type_), listChild(), childIndex() {}
     XMLNode(const XMLNode& src) = delete;
     
     XMLNodeType getType() const { return type; }
@@ -199,11 +235,79 @@ public:
     XMLNode& getFirstChild() { return listChild.getFirst(); }
     XMLNode& getLastChild() { return listChild.getLast(); }
     
-    XMLNode& appendChild(XMLNode& child) { return listChild.append(*this, child); }
-    XMLNode& insertBefore(XMLNode& child, XMLNode& ref) { return listChild.insertBefore(child, ref); }
-    XMLNode& removeChild(XMLNode& child) { return listChild.remove(child); }
+    XMLNode& appendChild(XMLNode& child) {
+        
+        childIndex = nullptr;
+        resetSource();
+        XMLNode* prev = listChild.empty() ? nullptr : &listChild.getLast();
+        listChild.append(*this, child);
+        child.linkSubtree(getSubtreeNext());
+        if(prev) prev->linkSubtree(&child);
+        return child;
+        
+    }
+    XMLNode& insertBefore(XMLNode& child, XMLNode& ref) {
+        
+        childIndex = nullptr;
+        resetSource();
+        XMLNode* prev = ref.prev;
+        listChild.insertBefore(child, ref);
+        child.linkSubtree(&ref);
+        if(prev) prev->linkSubtree(&child);
+        return child;
+        
+    }
+    XMLNode& removeChild(XMLNode& child) {
+        
+        childIndex = nullptr;
+        resetSource();
+        XMLNode* prev = child.prev;
+        XMLNode* next = child.next ? child.next : getSubtreeNext();
+        listChild.remove(child);
+        if(prev) prev->linkSubtree(next);
+        child.linkSubtree(nullptr);
+        return child;
+        
+    }
     bool hasChildNodes() { return !listChild.empty(); }
     
+    // Returns the node that follows this one and everything inside it in
+    // document order, or nullptr, so that a traversal can skip the subtree.
+    // Elements keep it as a link, which the methods here update; changes
+    // made through child() directly leave it stale.
+    XMLNode* getSubtreeNext();
+    // Clears the source range of the innermost element around this node and
+    // of the elements around that, see XMLElement::getSource()
+    void resetSource();
+    
+    // These take constant time, or logarithmic for findChildElement(), once
+    // XMLDocument::buildChildIndex() has run, and walk the children
+    // otherwise. Changes made through child() directly need
+    // resetChildIndex().
+    std::size_t childCount() {
+        
+        if(childIndex) return childIndex->count;
+        std::size_t count = 0;
+        for(auto it = listChild.begin(); it != listChild.end(); ++it) ++count;
+        return count;
+        
+    }
+    XMLNode& childAt(std::size_t i) {
+        
+        if(childIndex) { assert(i < childIndex->count); return *childIndex->getNodes()[i]; }
+        auto it = listChild.begin();
+        while(i--) ++it;
+        return *it;
+        
+    }
+    // Returns the first child element named name, or nullptr
+    XMLElement* findChildElement(StringView8 name);
+    // Returns the first child element with the atom, or nullptr. Atom 0
+    // matches nothing.
+    XMLElement* findChildElement(XMLAtom atom);
+    bool hasChildIndex() const { return childIndex; }
+    void resetChildIndex() { childIndex = nullptr; }
+    
     XMLElement& asElement() noexcept { return reinterpret_cast<XMLElement&>(*this); }
     const XMLElement& asElement() const noexcept { return reinterpret_cast<const XMLElement&>(*this); }
     XMLText& asText() noexcept { return reinterpret_cast<XMLText&>(*this); }
@@ -217,6 +321,11 @@ public:
     XMLDocument& asDocument() noexcept { return reinterpret_cast<XMLDocument&>(*this); }
     const XMLDocument& asDocument() const noexcept { return reinterpret_cast<const XMLDocument&>(*this); }
     
+private:
+    
+    // Sets the link of this element, and of its last child and so on, to next
+    void linkSubtree(XMLNode* next);
+    
 };
 
 class XMLAttribute : public Impl::List<XMLAttribute>::ListElement {
@@ -229,50 +338,249 @@ private:
     
     StringView8 name;
     StringView8 value;
+    XMLAtom atom;
     
 public:
     
-    XMLAttribute() : Impl::List<XMLAttribute>::ListElement(), name(), value() {}
+    XMLAttribute() : Impl::List<XMLAttribute>::ListElement(), name(), value(), atom() {}
     XMLAttribute(StringView8 name_, StringView8 value_) :
-        Impl::List<XMLAttribute>::ListElement(), name(name_), value(value_) {}
+        Impl::List<XMLAttribute>::ListElement(), name(name_), value(value_), atom() {}
     XMLAttribute(const XMLAttribute& src) = delete;
     
     StringView8 getName() const { return name; }
-    void setName(StringView8 name_) { name = name_; }
+    // Also clears the atom
+    void setName(StringView8 name_);
     StringView8 getValue() const { return value; }
-    void setValue(StringView8 value_) { value = value_; }
+    void setValue(StringView8 value_) { value = value_; if(parent) parent->resetSource(); }
+    // The atom of the name, 0 if it has none
+    XMLAtom getAtom() const { return atom; }
+    void setAtom(XMLAtom atom_) { atom = atom_; }
 
 };
 
+namespace Impl {
+
+// Hash table with open addressing from the names of the attributes of an
+// element to the attributes, kept in the memory of the document
+class AttributeIndex {
+    
+private:
+    
+    using StringView8 = Corecat::StringView8;
+    
+    struct Slot {
+        
+        std::uint32_t hash;
+        XMLAttribute* attribute;
+        
+    };
+    
+private:
+    
+    std::size_t mask;
+    
+private:
+    
+    Slot* getSlots() { return reinterpret_cast<Slot*>(this + 1); }
+    
+public:
+    
+    // Indexes the attributes in list, keeping the first one of each name
+    template <typename A>
+    static AttributeIndex* create(A& allocator, List<XMLAttribute>& list) {
+        
+        std::size_t count = 0;
+        for(auto it = list.begin(); it != list.end(); ++it) ++count;
+        std::size_t capacity = 4;
+        while(capacity * 3 < count * 4) capacity *= 2;
+        auto index = new(allocator.allocate(sizeof(AttributeIndex) + sizeof(Slot) * capacity)) AttributeIndex;
+        index->mask = capacity - 1;
+        auto slots = index->getSlots();
+        for(std::size_t i = 0; i < capacity; ++i) slots[i].attribute = nullptr;
+        for(auto& attr : list) {
+            
+            const auto h = hashName(attr.getName());
+            std::size_t i = h & index->mask;
+            for(; slots[i].attribute; i = (i + 1) & index->mask)
+                if(slots[i].hash == h && equalName(slots[i].attribute->getName(), attr.getName())) break;
+            if(!slots[i].attribute) slots[i] = {h, &attr};
+            
+        }
+        return index;
+        
+    }
+    
+    XMLAttribute* find(StringView8 name) {
+        
+        const auto h = hashName(name);
+        auto slots = getSlots();
+        for(std::size_t i = h & mask; slots[i].attribute; i = (i + 1) & mask)
+            if(slots[i].hash == h && equalName(slots[i].attribute->getName(), name)) return slots[i].attribute;
+        return nullptr;
+        
+    }
+    
+};
+
+}
+
 class XMLElement : public XMLNode {
     
 private:
     
     using StringView8 = Corecat::StringView8;
     
+private:
+    
+    friend class XMLNode;
+    friend class XMLDocument;
+    
 private:
     
     Impl::List<XMLAttribute> listAttr;
     StringView8 name;
+    // Built by findAttribute() once it passes IndexThreshold attributes,
+    // dropped when the attributes change
+    Impl::AttributeIndex* attrIndex;
+    XMLAtom atom;
+    // Where the element was parsed from, from < to the final >
+    StringView8 source;
+    // The node after the element and its content, see getSubtreeNext()
+    XMLNode* subtreeNext;
     
 public:
     
-    XMLElement() : XMLNode(XMLNodeType::Element), listAttr(), name() {}
-    XMLElement(StringView8 name_) : XMLNode(XMLNodeType::Element), listAttr(), name(name_) {}
+    static constexpr std::size_t IndexThreshold = 8;
+    
+public:
+    
+    XMLElement() : XMLNode(XMLNodeType::Element), listAttr(), name(), attrIndex(), atom(), source(), subtreeNext() {}
+    XMLElement(StringView8 name_) : XMLNode(XMLNodeType::Element), listAttr(), name(name_), attrIndex(), atom(), source(), subtreeNext() {}
     XMLElement(const XMLElement& src) = delete;
     
     Impl::List<XMLAttribute>& attribute() { return listAttr; }
     
     StringView8 getName() const { return name; }
-    void setName(StringView8 name_) { name = name_; }
+    // Also clears the atom
+    void setName(StringView8 name_) {
+        
+        name = name_;
+        atom = 0;
+        if(parent) parent->resetChildIndex();
+        resetSource();
+        
+    }
+    // The atom of the name, 0 if it has none
+    XMLAtom getAtom() const { return atom; }
+    void setAtom(XMLAtom atom_) { atom = atom_; }
     
     XMLAttribute& getFirstAttribute() { return listAttr.getFirst(); }
     XMLAttribute& getLastAttribute() { return listAttr.getLast(); }
-    XMLAttribute& appendAttribute(XMLAttribute& attr) { return listAttr.append(*this, attr); }
-    XMLAttribute& removeAttribute(XMLAttribute& attr) { return listAttr.remove(attr); }
+    XMLAttribute& appendAttribute(XMLAttribute& attr) { attrIndex = nullptr; resetSource(); return listAttr.append(*this, attr); }
+    XMLAttribute& removeAttribute(XMLAttribute& attr) { attrIndex = nullptr; resetSource(); return listAttr.remove(attr); }
+    // Returns the first attribute named name, or nullptr. Elements with many
+    // attributes get an index in their document, so lookups on them do not
+    // scan. Changes made through attribute() directly need
+    // resetAttributeIndex().
+    XMLAttribute* findAttribute(StringView8 name_);
+    // Returns the first attribute with the atom, or nullptr. Atom 0, which
+    // XMLAtomTable::find() returns for unknown names, matches nothing.
+    XMLAttribute* findAttribute(XMLAtom atom_) {
+        
+        if(!atom_) return nullptr;
+        for(auto& attr : listAttr) if(attr.getAtom() == atom_) return &attr;
+        return nullptr;
+        
+    }
+    // Like findAttribute(), but throws XMLDOMException if there is none
+    XMLAttribute& getAttribute(StringView8 name_) {
+        
+        if(auto attr = findAttribute(name_)) return *attr;
+        throw XMLDOMException("Attribute not found");
+        
+    }
+    void resetAttributeIndex() { attrIndex = nullptr; }
+    
+    // The bytes the element was parsed from, from its < to the > that ends
+    // it, or an empty view. It is empty for elements that were created, or
+    // that were changed or had their content changed after parsing, and
+    // for the elements parsed by XMLParallelParser. The bytes are those of
+    // the data, which a destructive parse may have changed inside them.
+    StringView8 getSource() const { return source; }
+    bool hasSource() const { return source.getLength(); }
     
 };
 
+inline XMLElement* XMLNode::findChildElement(StringView8 name) {
+    
+    if(childIndex) {
+        
+        auto first = childIndex->getElements(), last = first + childIndex->elementCount;
+        auto it = std::lower_bound(first, last, name, [](XMLElement* element, StringView8 n) { return Impl::compareName(element->getName(), n) < 0; });
+        return it != last && Impl::equalName((*it)->getName(), name) ? *it : nullptr;
+        
+    }
+    for(auto& node : listChild)
+        if(node.getType() == XMLNodeType::Element && Impl::equalName(node.asElement().getName(), name)) return &node.asElement();
+    return nullptr;
+
+}
+
+inline XMLElement* XMLNode::findChildElement(XMLAtom atom) {
+    
+    if(!atom) return nullptr;
+    for(auto& node : listChild)
+        if(node.getType() == XMLNodeType::Element && node.asElement().getAtom() == atom) return &node.asElement();
+    return nullptr;
+
+}
+
+inline void XMLAttribute::setName(StringView8 name_) {
+    
+    name = name_;
+    atom = 0;
+    if(parent) {
+        
+        parent->asElement().resetAttributeIndex();
+        parent->resetSource();
+        
+    }
+
+}
+
+inline XMLNode* XMLNode::getSubtreeNext() {
+    
+    if(type == XMLNodeType::Element) return asElement().subtreeNext;
+    if(next) return next;
+    return parent && parent->type == XMLNodeType::Element ? parent->asElement().subtreeNext : nullptr;
+
+}
+
+inline void XMLNode::resetSource() {
+    
+    // An element without a source range has none around it either, which
+    // also keeps this cheap while parsing, when the open elements have none
+    for(XMLNode* node = type == XMLNodeType::Element ? this : parent; node && node->type == XMLNodeType::Element; node = node->parent) {
+        
+        auto& element = node->asElement();
+        if(!element.source.getLength()) break;
+        element.source = StringView8();
+        
+    }
+
+}
+
+inline void XMLNode::linkSubtree(XMLNode* next_) {
+    
+    for(XMLNode* node = this; node->type == XMLNodeType::Element; node = &node->listChild.getLast()) {
+        
+        node->asElement().subtreeNext = next_;
+        if(node->listChild.empty()) break;
+        
+    }
+
+}
+
 class XMLText : public XMLNode {
     
 private:
@@ -290,7 +598,7 @@ public:
     XMLText(const XMLText& src) = delete;
     
     StringView8 getValue() const { return value; }
-    void setValue(StringView8 value_) { value = value_; }
+    void setValue(StringView8 value_) { value = value_; resetSource(); }
     
 };
 
@@ -311,7 +619,7 @@ public:
     XMLCDATA(const XMLCDATA& src) = delete;
     
     StringView8 getValue() const { return value; }
-    void setValue(StringView8 value_) { value = value_; }
+    void setValue(StringView8 value_) { value = value_; resetSource(); }
     
 };
 
@@ -332,7 +640,7 @@ public:
     XMLComment(const XMLComment& src) = delete;
     
     StringView8 getValue() const { return value; }
-    void setValue(StringView8 value_) { value = value_; }
+    void setValue(StringView8 value_) { value = value_; resetSource(); }
     
 };
 
@@ -355,12 +663,35 @@ public:
     XMLProcessingInstruction(const XMLProcessingInstruction& src) = delete;
     
     StringView8 getName() const { return name; }
-    void setName(StringView8 name_) { name = name_; }
+    void setName(StringView8 name_) { name = name_; resetSource(); }
     StringView8 getValue() const { return value; }
-    void setValue(StringView8 value_) { value = value_; }
+    void setValue(StringView8 value_) { value = value_; resetSource(); }
     
 };
 
+namespace Impl {
+
+// Call handler.startElement(name, atom) and handler.attribute(name, value,
+// atom) if the handler has them, the overloads without the atom otherwise
+template <typename H>
+auto startElement(H& handler, Corecat::StringView8 name, XMLAtom atom, int) -> decltype(handler.startElement(name, atom)) {
+    
+    return handler.startElement(name, atom);
+
+}
+template <typename H>
+void startElement(H& handler, Corecat::StringView8 name, XMLAtom /*atom*/, long) { handler.startElement(name); }
+template <typename H>
+auto attribute(H& handler, Corecat::StringView8 name, Corecat::StringView8 value, XMLAtom atom, int) -> decltype(handler.attribute(name, value, atom)) {
+    
+    return handler.attribute(name, value, atom);
+
+}
+template <typename H>
+void attribute(H& handler, Corecat::StringView8 name, Corecat::StringView8 value, XMLAtom /*atom*/, long) { handler.attribute(name, value); }
+
+}
+
 class XMLDocument : public XMLNode {
     
 private:
@@ -370,23 +701,126 @@ private:
     using StringView8 = Corecat::StringView8;
     using FastAllocator = Corecat::FastAllocator<>;
     
+private:
+    
+    friend class XMLElement;
+    // Build documents with the builders below
+    friend class XMLParallelParser;
+    friend class XMLStructuralIndex;
+    
 private:
     
     FastAllocator allocator;
+    XMLAtomTable* atomTable;
+    
+private:
+    
+    class Builder : public XMLHandlerBase {
+        
+    private:
+        
+        XMLDocument* document;
+        // Gives the ends of the source ranges; without it there are none
+        const XMLParser* parser;
+        XMLNode* cur;
+        // Closed elements waiting for the next node to link to
+        std::vector<XMLElement*> pending;
+        
+    private:
+        
+        // Appends without the work of appendChild(), like attribute() does
+        // without appendAttribute(), since the links are set from pending
+        // and there are no ranges or indices to clear yet
+        void append(XMLNode& node) {
+            
+            cur->listChild.append(*cur, node);
+            for(auto element : pending) element->subtreeNext = &node;
+            pending.clear();
+            
+        }
+        void close() {
+            
+            auto& element = cur->asElement();
+            if(parser) element.source.setLength(parser->getPosition() - element.source.getData());
+            pending.push_back(&element);
+            cur = cur->parent;
+            
+        }
+        
+    public:
+        
+        Builder(XMLDocument* document_, const XMLParser* parser_ = nullptr) : document(document_), parser(parser_), cur(nullptr), pending() {}
+        
+        void startDocument() { cur = document; }
+        void startElement(StringView8 name) {
+            
+            auto& element = document->createElement(name);
+            // Names are never copied, so the < is right before the name
+            if(parser) element.source = StringView8(name.getData() - 1, 0);
+            append(element);
+            cur = &element;
+            
+        }
+        void endElement(StringView8 /*name*/) {
+            
+            close();
+            
+        }
+        void endAttributes(bool empty) {
+            
+            if(empty) close();
+            
+        }
+        void attribute(StringView8 name, StringView8 value) {
+            
+            cur->asElement().listAttr.append(*cur, document->createAttribute(name, value));
+            
+        }
+        void text(StringView8 value) {
+            
+            append(document->createText(value));
+            
+        }
+        void cdata(StringView8 value) {
+            
+            append(document->createCDATA(value));
+            
+        }
+        void comment(StringView8 value) {
+            
+            append(document->createComment(value));
+            
+        }
+        void processingInstruction(StringView8 name, StringView8 value) {
+            
+            append(document->createProcessingInstruction(name, value));
+            
+        }
+        
+    };
     
 public:
     
-    XMLDocument() : XMLNode(XMLNodeType::Document), allocator() {}
+    XMLDocument() : XMLNode(XMLNodeType::Document), allocator(), atomTable() {}
     XMLDocument(const XMLDocument& src) = delete;
     
+    // With an atom table, the elements and attributes created, also by
+    // parse(), get the atoms of their names. nullptr turns this off.
+    XMLAtomTable* getAtomTable() const { return atomTable; }
+    void setAtomTable(XMLAtomTable* atomTable_) { atomTable = atomTable_; }
+    
     XMLElement& createElement(StringView8 name) {
         
-        return *new(allocator.allocate(sizeof(XMLElement))) XMLElement(name);
+        auto& element = *new(allocator.allocate(sizeof(XMLElement))) XMLElement(name);
+        if(atomTable) element.setAtom(atomTable->intern(name));
+        return element;
         
     }
     XMLAttribute& createAttribute(StringView8 name, StringView8 value) {
         
-        return *new(allocator.allocate(sizeof(XMLAttribute))) XMLAttribute(name, value);
+        auto& attr = *new(allocator.allocate(sizeof(XMLAttribute))) XMLAttribute(name, value);
+        if(atomTable) attr.setAtom(atomTable->intern(name));
+        return attr;
         
     }
     XMLText& createText(StringView8 value) {
@@ -412,155 +846,177 @@ public:
     
     void clear() {
         
+        child().clear();
+        resetChildIndex();
         allocator.clear();
         
     }
     
     XMLElement& getRootElement() {
         
+        if(childIndex && childIndex->firstElement) return *childIndex->firstElement;
         for(auto& node : child()) if(node.getType() == XMLNodeType::Element) return static_cast<XMLElement&>(node);
         throw XMLDOMException("Root element not found");
         
     }
-    
-    template <XMLParser::Flag F = XMLParser::Flag::Default>
-    void parse(char* data) {
+    // Builds arrays of the children of every node in the document, see
+    // XMLNode::childCount(). The arrays stay in the document until clear().
+    void buildChildIndex() {
         
-        class Handler : public XMLHandlerBase {
-            
-        private:
-            
-            XMLDocument* document;
-            XMLNode* cur;
+        std::vector<XMLNode*> stack(1, this);
+        while(!stack.empty()) {
             
-        public:
-            
-            Handler(XMLDocument* document_) : document(document_), cur(nullptr) {}
-            
-            void startDocument() { cur = document; }
-            void startElement(StringView8 name) {
+            auto node = stack.back();
+            stack.pop_back();
+            std::size_t count = 0, elementCount = 0;
+            for(auto& child : node->child()) {
                 
-                auto& element = document->createElement(name);
-                cur->appendChild(element);
-                cur = &element;
+                ++count;
+                if(child.getType() == XMLNodeType::Element) ++elementCount;
+                if(child.hasChildNodes()) stack.push_back(&child);
                 
             }
-            void endElement(StringView8 /*name*/) {
+            if(!count) continue;
+            auto index = new(allocator.allocate(sizeof(Impl::ChildIndex) + sizeof(XMLNode*) * (count + elementCount))) Impl::ChildIndex;
+            index->count = count;
+            index->elementCount = elementCount;
+            index->firstElement = nullptr;
+            auto nodes = index->getNodes();
+            auto elements = index->getElements();
+            for(auto& child : node->child()) {
                 
-                cur = cur->parent;
+                *nodes++ = &child;
+                if(child.getType() == XMLNodeType::Element) *elements++ = &child.asElement();
                 
             }
-            void endAttributes(bool empty) {
+            elements = index->getElements();
+            if(elementCount) index->firstElement = elements[0];
+            // Stable, so that findChildElement() finds the first of a name
+            auto less = [](XMLElement* a, XMLElement* b) { return Impl::compareName(a->getName(), b->getName()) < 0; };
+            if(elementCount <= 16) {
                 
-                if(empty) cur = cur->parent;
+                for(std::size_t i = 1; i < elementCount; ++i)
+                    for(std::size_t j = i; j && less(elements[j], elements[j - 1]); --j) std::swap(elements[j], elements[j - 1]);
                 
-            }
-            void attribute(StringView8 name, StringView8 value) {
+            } else if(!std::is_sorted(elements, elements + elementCount, less)) std::stable_sort(elements, elements + elementCount, less);
+            node->childIndex = index;
+            
+        }
+        
+    }
+    
+    template <XMLParser::Flag F = XMLParser::Flag::Default>
+    void parse(char* data) {
+        
+        assert(data);
+        
+        clear();
+        XMLParser parser(allocator);
+        Builder builder(this, &parser);
+        parser.parse<F>(data, builder);
+        
+    }
+    template <XMLParser::Flag F = XMLParser::Flag::Default>
+    void parse(char* data, std::size_t length) {
+        
+        assert(data || !length);
+        
+        clear();
+        XMLParser parser(allocator);
+        Builder builder(this, &parser);
+        parser.parse<F>(data, length, builder);
+        
+    }
+    template <XMLParser::Flag F = XMLParser::Flag::Default>
+    void parse(const char* data) {
+        
+        parse<F | XMLParser::Flag::NonDestructive>(const_cast<char*>(data));
+        
+    }
+    template <XMLParser::Flag F = XMLParser::Flag::Default>
+    void parse(const char* data, std::size_t length) {
+        
+        parse<F | XMLParser::Flag::NonDestructive>(const_cast<char*>(data), length);
+        
+    }
+    template <typename H>
+    void visit(H& handler) {
+        
+        handler.startDocument();
+        if(hasChildNodes()) visit(getFirstChild(), getLastChild(), handler);
+        handler.endDocument();
+        
+    }
+    // Reports the siblings from first to last and everything inside them,
+    // without startDocument() and endDocument()
+    template <typename H>
+    static void visit(XMLNode& first, XMLNode& last, H& handler) {
+        
+        XMLNode* const parent = first.parent;
+        XMLNode* cur = &first;
+        while(true) {
+            
+            switch(cur->getType()) {
+            
+            case XMLNodeType::Element: {
                 
-                static_cast<XMLElement*>(cur)->appendAttribute(document->createAttribute(name, value));
+                auto& element = static_cast<XMLElement&>(*cur);
+                Impl::startElement(handler, element.getName(), element.getAtom(), 0);
+                for(auto& attr : element.attribute())
+                    Impl::attribute(handler, attr.getName(), attr.getValue(), attr.getAtom(), 0);
+                bool empty = !cur->hasChildNodes();
+                handler.endAttributes(empty);
+                if(!empty) { cur = &cur->getFirstChild(); continue; }
+                break;
                 
             }
-            void text(StringView8 value) {
+            case XMLNodeType::Text: {
                 
-                cur->appendChild(document->createText(value));
+                auto& text = static_cast<XMLText&>(*cur);
+                handler.text(text.getValue());
+                break;
                 
             }
-            void cdata(StringView8 value) {
+            case XMLNodeType::CDATA: {
                 
-                cur->appendChild(document->createCDATA(value));
+                auto& cdata = static_cast<XMLCDATA&>(*cur);
+                handler.cdata(cdata.getValue());
+                break;
                 
             }
-            void comment(StringView8 value) {
+            case XMLNodeType::Comment: {
                 
-                cur->appendChild(document->createComment(value));
+                auto& comment = static_cast<XMLComment&>(*cur);
+                handler.comment(comment.getValue());
+                break;
                 
             }
-            void processingInstruction(StringView8 name, StringView8 value) {
+            case XMLNodeType::ProcessingInstruction: {
                 
-                cur->appendChild(document->createProcessingInstruction(name, value));
+                auto& pi = static_cast<XMLProcessingInstruction&>(*cur);
+                handler.processingInstruction(pi.getName(), pi.getValue());
+                break;
                 
             }
-            
-        };
-        
-        assert(data);
-        
-        clear();
-        XMLParser parser;
-        Handler handler(this);
-        parser.parse<F>(data, handler);
-        
-    }
-    
-    template <typename H>
-    void visit(H& handler) {
-        
-        handler.startDocument();
-        if(hasChildNodes()) {
-            
-            XMLNode* cur = &getFirstChild();
-            while(true) {
+            default: throw XMLDOMException("Invalid node type");
                 
-                switch(cur->getType()) {
+            }
+            while(true) {
                 
-                case XMLNodeType::Element: {
-                    
-                    auto& element = static_cast<XMLElement&>(*cur);
-                    handler.startElement(element.getName());
-                    for(auto& attr : element.attribute())
-                        handler.attribute(attr.getName(), attr.getValue());
-                    bool empty = !cur->hasChildNodes();
-                    handler.endAttributes(empty);
-                    if(!empty) { cur = &cur->getFirstChild(); continue; }
-                    break;
-                    
-                }
-                case XMLNodeType::Text: {
+                if(cur->parent == parent) {
                     
-                    auto& text = static_cast<XMLText&>(*cur);
-                    handler.text(text.getValue());
+                    if(cur == &last) return;
+                    cur = cur->next;
                     break;
                     
                 }
-                case XMLNodeType::CDATA: {
-                    
-                    auto& cdata = static_cast<XMLCDATA&>(*cur);
-                    handler.cdata(cdata.getValue());
-                    break;
-                    
-                }
-                case XMLNodeType::Comment: {
-                    
-                    auto& comment = static_cast<XMLComment&>(*cur);
-                    handler.comment(comment.getValue());
-                    break;
-                    
-                }
-                case XMLNodeType::ProcessingInstruction: {
-                    
-                    auto& pi = static_cast<XMLProcessingInstruction&>(*cur);
-                    handler.processingInstruction(pi.getName(), pi.getValue());
-                    break;
-                    
-                }
-                default: throw XMLDOMException("Invalid node type");
-                
-                }
-                while(!cur->next) {
-                    
-                    cur = cur->parent;
-                    if(cur == this) break;
-                    auto name = static_cast<XMLElement*>(cur)->getName();
-                    handler.endElement(name);
-                    
-                }
-                if(cur == this) break;
-                cur = cur->next;
+                if(cur->next) { cur = cur->next; break; }
+                cur = cur->parent;
+                handler.endElement(static_cast<XMLElement*>(cur)->getName());
                 
             }
             
         }
-        handler.endDocument();
         
     }
     void serialize(OutputStream<char>& stream) {
@@ -569,9 +1025,61 @@ public:
         visit(serializer);
         
     }
+    // Serializes with a formatting policy, e.g. XMLIndentFormat
+    template <typename Format>
+    void serialize(OutputStream<char>& stream, Format format) {
+        
+        BasicXMLSerializer<XMLStreamSink, Format> serializer(stream, format);
+        visit(serializer);
+        
+    }
+    // Returns the size of the output of serialize(), with the same escaping
+    template <typename Format = XMLCompactFormat>
+    std::size_t serializedSize(Format format = Format()) {
+        
+        BasicXMLSerializer<XMLCountingSink, Format> serializer(XMLCountingSink(), format);
+        visit(serializer);
+        return serializer.getSink().getLength();
+        
+    }
+    // Writes to the buffer at data and returns the size of the output. If it
+    // is larger than capacity, only the first capacity bytes were written.
+    template <typename Format = XMLCompactFormat>
+    std::size_t serialize(char* data, std::size_t capacity, Format format = Format()) {
+        
+        assert(data || !capacity);
+        
+        BasicXMLSerializer<XMLBufferSink, Format> serializer(XMLBufferSink(data, capacity), format);
+        visit(serializer);
+        return serializer.getSink().getLength();
+        
+    }
     
 };
 
+inline XMLAttribute* XMLElement::findAttribute(StringView8 name_) {
+    
+    if(attrIndex) return attrIndex->find(name_);
+    std::size_t count = 0;
+    XMLAttribute* result = nullptr;
+    for(auto& attr : listAttr) {
+        
+        if(Impl::equalName(attr.getName(), name_)) { result = &attr; break; }
+        ++count;
+        
+    }
+    if(count >= IndexThreshold) {
+        
+        // The index lives in the document, so detached elements do without
+        XMLNode* node = this;
+        while(node->parent) node = node->parent;
+        if(node->getType() == XMLNodeType::Document) attrIndex = Impl::AttributeIndex::create(node->asDocument().allocator, listAttr);
+        
+    }
+    return result;
+
+}
+
 inline std::ostream& operator <<(std::ostream& stream, XMLDocument& document) {
     
     auto wrapper = Corecat::createWrapperOutputStream(stream);
@@ -0,0 +1,361 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CATS_TEXTCAT_XML_FLATDOCUMENT_HPP
+#define CATS_TEXTCAT_XML_FLATDOCUMENT_HPP
+
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include <iostream>
+#include <vector>
+
+#include "Cats/Corecat/Data/Stream.hpp"
+#include "Cats/Corecat/Text/String.hpp"
+
+#include "AtomTable.hpp"
+#include "Document.hpp"
+#include "Handler.hpp"
+#include "Parser.hpp"
+#include "Serializer.hpp"
+
+
+namespace Cats {
+namespace Textcat{
+inline namespace XML {
+
+// A read-only DOM kept in one array of nodes in document order. Nodes refer
+// to each other by 32-bit indices, and names and values are offsets into the
+// parsed data, so the data has to outlive the document. The nodes inside a
+// node are the ones after it up to getSubtreeEnd(), so a traversal reads the
+// array from front to back.
+class XMLFlatDocument {
+    
+public:
+    
+    using Index = std::uint32_t;
+    
+    static constexpr Index None = 0xFFFFFFFF;
+    
+private:
+    
+    template <typename T>
+    using OutputStream = Corecat::OutputStream<T>;
+    using StringView8 = Corecat::StringView8;
+    
+private:
+    
+    // Offsets below the length of the data point into it, the others into
+    // the pool
+    struct Span {
+        
+        std::uint32_t offset;
+        std::uint32_t length;
+        
+    };
+    struct Node {
+        
+        XMLNodeType type;
+        Index parent;
+        // One past the last node inside this one
+        Index end;
+        // The attributes of the node end where those of the next node begin
+        Index firstAttribute;
+        Span name;
+        Span value;
+        
+    };
+    struct Attribute {
+        
+        Span name;
+        Span value;
+        
+    };
+    
+    class Builder : public XMLHandlerBase {
+        
+    private:
+        
+        XMLFlatDocument* document;
+        Index cur;
+        
+    private:
+        
+        void add(XMLNodeType type, StringView8 name, StringView8 value) {
+            
+            auto& nodes = document->nodes;
+            if(nodes.size() >= None) throw XMLDOMException("Too many nodes");
+            const auto index = static_cast<Index>(nodes.size());
+            nodes.push_back({type, cur, index + 1, static_cast<Index>(document->attributes.size()), document->span(name), document->span(value)});
+            
+        }
+        void close() {
+            
+            auto& node = document->nodes[cur];
+            node.end = static_cast<Index>(document->nodes.size());
+            cur = node.parent;
+            
+        }
+        
+    public:
+        
+        Builder(XMLFlatDocument* document_) : document(document_), cur(None) {}
+        
+        void startDocument() { cur = None; }
+        void startElement(StringView8 name) {
+            
+            add(XMLNodeType::Element, name, StringView8());
+            cur = static_cast<Index>(document->nodes.size() - 1);
+            
+        }
+        void endElement(StringView8 /*name*/) { close(); }
+        void endAttributes(bool empty) { if(empty) close(); }
+        void attribute(StringView8 name, StringView8 value) {
+            
+            auto& attributes = document->attributes;
+            if(attributes.size() >= None) throw XMLDOMException("Too many attributes");
+            attributes.push_back({document->span(name), document->span(value)});
+            
+        }
+        void text(StringView8 value) { add(XMLNodeType::Text, StringView8(), value); }
+        void cdata(StringView8 value) { add(XMLNodeType::CDATA, StringView8(), value); }
+        void comment(StringView8 value) { add(XMLNodeType::Comment, StringView8(), value); }
+        void processingInstruction(StringView8 name, StringView8 value) { add(XMLNodeType::ProcessingInstruction, name, value); }
+        
+    };
+    
+private:
+    
+    const char* data;
+    std::size_t length;
+    // Values the parser did not leave in the data, e.g. with entities
+    // translated by Flag::NonDestructive
+    std::vector<char> pool;
+    std::vector<Node> nodes;
+    std::vector<Attribute> attributes;
+    
+private:
+    
+    Span span(StringView8 value) {
+        
+        if(!value.getLength()) return {0, 0};
+        const char* p = value.getData();
+        if(p >= data && p < data + length) return {static_cast<std::uint32_t>(p - data), static_cast<std::uint32_t>(value.getLength())};
+        const std::size_t offset = length + pool.size();
+        if(offset + value.getLength() > None) throw XMLDOMException("Document too large");
+        pool.insert(pool.end(), p, p + value.getLength());
+        return {static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(value.getLength())};
+        
+    }
+    StringView8 resolve(Span s) const {
+        
+        if(!s.length) return StringView8();
+        return StringView8(s.offset < length ? data + s.offset : pool.data() + (s.offset - length), s.length);
+        
+    }
+    
+public:
+    
+    XMLFlatDocument() : data(), length(), pool(), nodes(), attributes() {}
+    XMLFlatDocument(const XMLFlatDocument& src) = delete;
+    
+    void clear() {
+        
+        data = nullptr;
+        length = 0;
+        pool.clear();
+        nodes.clear();
+        attributes.clear();
+        
+    }
+    
+    // The number of nodes; they have the indices 0 to getSize() - 1
+    std::size_t getSize() const { return nodes.size(); }
+    std::size_t getAttributeSize() const { return attributes.size(); }
+    
+    XMLNodeType getType(Index node) const { assert(node < nodes.size()); return nodes[node].type; }
+    // The name of an element or processing instruction
+    StringView8 getName(Index node) const { assert(node < nodes.size()); return resolve(nodes[node].name); }
+    // The value of a text, CDATA, comment or processing instruction
+    StringView8 getValue(Index node) const { assert(node < nodes.size()); return resolve(nodes[node].value); }
+    
+    // None for the nodes at the top level
+    Index getParent(Index node) const { assert(node < nodes.size()); return nodes[node].parent; }
+    Index getSubtreeEnd(Index node) const { assert(node < nodes.size()); return nodes[node].end; }
+    bool hasChildNodes(Index node) const { assert(node < nodes.size()); return nodes[node].end != node + 1; }
+    Index getFirstChild(Index node) const { return hasChildNodes(node) ? node + 1 : None; }
+    Index getNextSibling(Index node) const {
+        
+        assert(node < nodes.size());
+        const Index next = nodes[node].end;
+        const Index parent = nodes[node].parent;
+        return next < (parent == None ? nodes.size() : nodes[parent].end) ? next : None;
+        
+    }
+    Index getRootElement() const {
+        
+        for(Index node = 0; node < nodes.size(); node = nodes[node].end)
+            if(nodes[node].type == XMLNodeType::Element) return node;
+        throw XMLDOMException("Root element not found");
+        
+    }
+    
+    // The attributes of an element are getFirstAttribute() to
+    // getAttributeEnd() - 1
+    Index getFirstAttribute(Index node) const { assert(node < nodes.size()); return nodes[node].firstAttribute; }
+    Index getAttributeEnd(Index node) const {
+        
+        assert(node < nodes.size());
+        return node + 1 < nodes.size() ? nodes[node + 1].firstAttribute : static_cast<Index>(attributes.size());
+        
+    }
+    StringView8 getAttributeName(Index attr) const { assert(attr < attributes.size()); return resolve(attributes[attr].name); }
+    StringView8 getAttributeValue(Index attr) const { assert(attr < attributes.size()); return resolve(attributes[attr].value); }
+    // Returns the first attribute of node named name, or None
+    Index findAttribute(Index node, StringView8 name) const {
+        
+        for(Index attr = getFirstAttribute(node), end = getAttributeEnd(node); attr < end; ++attr)
+            if(Impl::equalName(getAttributeName(attr), name)) return attr;
+        return None;
+        
+    }
+    
+    // Only the lengths are supported, since the names and values are found
+    // by their offsets into [data, data + length)
+    template <XMLParser::Flag F = XMLParser::Flag::Default>
+    void parse(char* data_, std::size_t length_) {
+        
+        assert(data_ || !length_);
+        
+        clear();
+        if(length_ >= None) throw XMLDOMException("Document too large");
+        data = data_;
+        length = length_;
+        try {
+            
+            XMLParser parser;
+            Builder builder(this);
+            parser.parse<F>(data_, length_, builder);
+            
+        } catch(...) { clear(); throw; }
+        
+    }
+    template <XMLParser::Flag F = XMLParser::Flag::Default>
+    void parse(const char* data_, std::size_t length_) {
+        
+        parse<F | XMLParser::Flag::NonDestructive>(const_cast<char*>(data_), length_);
+        
+    }
+    
+    template <typename H>
+    void visit(H& handler) const {
+        
+        handler.startDocument();
+        visit(0, static_cast<Index>(nodes.size()), handler);
+        handler.endDocument();
+        
+    }
+    // Reports the nodes first to last - 1, which have to be whole siblings,
+    // e.g. visit(node, getSubtreeEnd(node), handler) for one subtree
+    template <typename H>
+    void visit(Index first, Index last, H& handler) const {
+        
+        assert(first <= last && last <= nodes.size());
+        
+        if(first == last) return;
+        const Index parent = nodes[first].parent;
+        Index cur = parent;
+        for(Index i = first; i < last; ++i) {
+            
+            const Node& node = nodes[i];
+            for(; cur != node.parent; cur = nodes[cur].parent) handler.endElement(resolve(nodes[cur].name));
+            switch(node.type) {
+            
+            case XMLNodeType::Element: {
+                
+                handler.startElement(resolve(node.name));
+                for(Index attr = node.firstAttribute, end = getAttributeEnd(i); attr < end; ++attr)
+                    handler.attribute(resolve(attributes[attr].name), resolve(attributes[attr].value));
+                bool empty = node.end == i + 1;
+                handler.endAttributes(empty);
+                if(!empty) cur = i;
+                break;
+                
+            }
+            case XMLNodeType::Text: handler.text(resolve(node.value)); break;
+            case XMLNodeType::CDATA: handler.cdata(resolve(node.value)); break;
+            case XMLNodeType::Comment: handler.comment(resolve(node.value)); break;
+            case XMLNodeType::ProcessingInstruction: handler.processingInstruction(resolve(node.name), resolve(node.value)); break;
+            default: throw XMLDOMException("Invalid node type");
+                
+            }
+            
+        }
+        for(; cur != parent; cur = nodes[cur].parent) handler.endElement(resolve(nodes[cur].name));
+        
+    }
+    void serialize(OutputStream<char>& stream) const {
+        
+        XMLSerializer serializer(stream);
+        visit(serializer);
+        
+    }
+    // Serializes with a formatting policy, e.g. XMLIndentFormat
+    template <typename Format>
+    void serialize(OutputStream<char>& stream, Format format) const {
+        
+        BasicXMLSerializer<XMLStreamSink, Format> serializer(stream, format);
+        visit(serializer);
+        
+    }
+    // Returns the size of the output of serialize(), with the same escaping
+    template <typename Format = XMLCompactFormat>
+    std::size_t serializedSize(Format format = Format()) const {
+        
+        BasicXMLSerializer<XMLCountingSink, Format> serializer(XMLCountingSink(), format);
+        visit(serializer);
+        return serializer.getSink().getLength();
+        
+    }
+    
+};
+
+inline std::ostream& operator <<(std::ostream& stream, const XMLFlatDocument& document) {
+    
+    auto wrapper = Corecat::createWrapperOutputStream(stream);
+    document.serialize(wrapper);
+    return stream;
+
+}
+
+}
+}
+}
+
+
+#endif
@@ -35,6 +35,9 @@ namespace Cats {
 namespace Textcat{
 inline namespace XML {
 
+// A handler may also have startElement(name, atom) and attribute(name,
+// value, atom), which XMLDocument::visit() calls instead with the atoms of
+// the names (0 for none), see XMLAtomTable.
 class XMLHandlerBase {
     
 protected:
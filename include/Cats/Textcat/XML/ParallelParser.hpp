@@ -0,0 +1,580 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CATS_TEXTCAT_XML_PARALLELPARSER_HPP
+#define CATS_TEXTCAT_XML_PARALLELPARSER_HPP
+
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Cats/Corecat/Data/Allocator/FastAllocator.hpp"
+#include "Cats/Corecat/Text/String.hpp"
+#include "Cats/Corecat/Util/Sequence.hpp"
+
+#include "Document.hpp"
+#include "Handler.hpp"
+#include "Parser.hpp"
+
+
+namespace Cats {
+namespace Textcat{
+inline namespace XML {
+
+// Parses one document with several threads. The data is split into chunks
+// at a "<" after every chunkSize bytes, and each chunk is tokenized on its
+// own, assuming that it starts at a token. The calling thread replays the
+// chunks in order, which checks nesting and emits the events. A chunk whose
+// assumed start turns out to be inside a token of the chunk before (e.g. a
+// "<" in a comment or CDATA section) is parsed again from where that token
+// ends.
+class XMLParallelParser {
+    
+private:
+    
+    using StringView8 = Corecat::StringView8;
+    using FastAllocator = Corecat::FastAllocator<>;
+    using Flag = XMLParser::Flag;
+    
+    enum class EventType : std::uint8_t {
+        
+        StartElement,
+        Attribute,
+        EndAttributes,
+        EndElement,
+        Text,
+        CDATA,
+        Comment,
+        ProcessingInstruction,
+        
+    };
+    
+    // A handler call recorded by a worker. For text, name holds the raw
+    // characters, which have to be white space outside the root element.
+    struct Event {
+        
+        EventType type;
+        bool empty;
+        const char* pos;
+        StringView8 name;
+        StringView8 value;
+        
+    };
+    
+    // Chunks are recycled, so that their buffers are only allocated once
+    struct Chunk {
+        
+        std::size_t index;
+        const char* begin;
+        const char* end;
+        // Where parsing stopped, the next chunk has to begin there
+        const char* stop;
+        // Parsing stopped at the end of data
+        bool last;
+        bool done;
+        std::vector<Event> events;
+        std::exception_ptr error;
+        // Values decoded by the worker
+        FastAllocator arena;
+        
+        Chunk() : index(), begin(), end(), stop(), last(), done(), events(), error(), arena() {}
+        
+        void reset(std::size_t index_, const char* begin_, const char* end_) {
+            
+            index = index_;
+            begin = begin_;
+            end = end_;
+            done = false;
+            events.clear();
+            error = nullptr;
+            arena.clear();
+            
+        }
+        
+    };
+    
+    class Recorder : public XMLHandlerBase {
+        
+    private:
+        
+        Chunk* chunk;
+        StringView8 element;
+        const char* pos;
+        
+    private:
+        
+        void add(EventType type, StringView8 name, StringView8 value, bool empty = false) {
+            
+            chunk->events.push_back({type, empty, pos, name, value});
+            
+        }
+        
+    public:
+        
+        Recorder(Chunk& chunk_) : chunk(&chunk_), element(), pos() {}
+        
+        // Sets the start of the token being parsed
+        void setPosition(const char* pos_) { pos = pos_; }
+        
+        void startElement(StringView8 name) { element = name; add(EventType::StartElement, name, {}); }
+        void endElement(StringView8 name) { add(EventType::EndElement, name, {}); }
+        void endAttributes(bool empty) { add(EventType::EndAttributes, element, {}, empty); }
+        void attribute(StringView8 name, StringView8 value) { add(EventType::Attribute, name, value); }
+        void text(StringView8 value) { add(EventType::Text, {}, value); }
+        void cdata(StringView8 value) { add(EventType::CDATA, {}, value); }
+        void comment(StringView8 value) { add(EventType::Comment, {}, value); }
+        void processingInstruction(StringView8 name, StringView8 value) { add(EventType::ProcessingInstruction, name, value); }
+        
+    };
+    
+private:
+    
+    std::size_t threadCount;
+    std::size_t chunkSize;
+    std::size_t maxDepth;
+    
+private:
+    
+    // Tokenizes [chunk.begin, chunk.end) without knowing the nesting depth;
+    // the token that crosses chunk.end is finished. Errors are kept until the
+    // chunk is replayed, since the chunk may be parsed again.
+    // When guess holds the events of a parse that began at a wrong position,
+    // parsing stops as soon as a token begins where one of them does, since
+    // the rest of guess is right from there on. Returns that event.
+    template <Flag F>
+    static const Event* parseChunk(Chunk& chunk, const char* data, const char* end, const std::vector<Event>* guess = nullptr) {
+        
+        constexpr Flag G = F | XMLParser::Bounded | Flag::NonDestructive;
+        
+        // The data is not modified by a non-destructive parse
+        XMLParser parser(chunk.arena);
+        parser.s = const_cast<char*>(data);
+        parser.p = const_cast<char*>(chunk.begin);
+        parser.e = const_cast<char*>(end);
+        char*& p = parser.p;
+        Recorder recorder(chunk);
+        std::size_t k = 0;
+        try {
+            
+            while(p < chunk.end) {
+                
+                if(guess) {
+                    
+                    while(k != guess->size() && (*guess)[k].pos < p) ++k;
+                    if(k != guess->size() && (*guess)[k].pos == p) return &(*guess)[k];
+                    
+                }
+                recorder.setPosition(p);
+                if(!parser.peek<G>()) break;
+                if(*p != '<') {
+                    
+                    // Parse text, or white space outside the root element
+                    auto t = p;
+                    parser.skip<G, Impl::Space>();
+                    if(!parser.peek<G>()) break;
+                    if(!(F & Flag::TrimSpace)) p = t;
+                    if(parser.peek<G>() != '<') {
+                        
+                        parser.parseText<G>(recorder);
+                        chunk.events.back().name = StringView8(t, p - t);
+                        
+                    }
+                    continue;
+                    
+                }
+                
+                ++p;
+                switch(parser.peek<G>()) {
+                
+                case '!': {
+                    
+                    ++p;
+                    if(parser.match<G>("--")) {
+                        
+                        p += 2;
+                        parser.parseComment<G>(recorder);
+                        
+                    } else if(parser.match<G>("[CDATA[")) {
+                        
+                        p += 7;
+                        parser.parseCDATA<G>(recorder);
+                        
+                    } else if(parser.match<G>("DOCTYPE")) {
+                        
+                        p += 7;
+                        parser.parseDoctype<G>(recorder);
+                        
+                    } else throw XMLParseException("Unexpected character", p - data);
+                    break;
+                    
+                }
+                case '/': {
+                    
+                    // The start tag is not known yet, so the end tag is read
+                    // as is and matched when replayed
+                    ++p;
+                    parser.parseEndTag<G | Flag::ClosingTagValidate>(recorder, StringView8());
+                    break;
+                    
+                }
+                case '?': {
+                    
+                    ++p;
+                    parser.parseProcessingInstruction<G>(recorder);
+                    break;
+                    
+                }
+                default: {
+                    
+                    StringView8 name;
+                    parser.parseStartTag<G>(recorder, name);
+                    break;
+                    
+                }
+                    
+                }
+                
+            }
+            
+        } catch(...) { chunk.error = std::current_exception(); }
+        chunk.stop = p;
+        chunk.last = !chunk.error && !parser.peek<G>();
+        return nullptr;
+        
+    }
+    // Emits the events [first, last), stack holds the open elements
+    template <Flag F, typename H>
+    void replay(const Event* first, const Event* last, const char* data, std::vector<StringView8>& stack, H& handler) const {
+        
+        using namespace Corecat::Util;
+        
+        for(; first != last; ++first) {
+            
+            auto& event = *first;
+            switch(event.type) {
+            
+            case EventType::StartElement: {
+                
+                if(stack.size() >= maxDepth) throw XMLParseException("Element nesting too deep", event.pos - data);
+                handler.startElement(event.name);
+                break;
+                
+            }
+            case EventType::Attribute: {
+                
+                handler.attribute(event.name, event.value);
+                break;
+                
+            }
+            case EventType::EndAttributes: {
+                
+                if(!event.empty) stack.push_back(event.name);
+                handler.endAttributes(event.empty);
+                break;
+                
+            }
+            case EventType::EndElement: {
+                
+                if(stack.empty()) throw XMLParseException("Expected element type", event.pos + 1 - data);
+                if(!(F & Flag::ClosingTagValidate) && event.name != stack.back())
+                    throw XMLParseException("Unmatch element type", event.pos + 2 - data);
+                stack.pop_back();
+                handler.endElement(event.name);
+                break;
+                
+            }
+            case EventType::Text: {
+                
+                if(stack.empty()) {
+                    
+                    auto t = event.name.getData();
+                    for(; t != event.name.getData() + event.name.getLength(); ++t)
+                        if(!SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(*t))
+                            throw XMLParseException("Expected <", t - data);
+                    
+                } else handler.text(event.value);
+                break;
+                
+            }
+            case EventType::CDATA: {
+                
+                if(stack.empty()) throw XMLParseException("Unexpected character", event.pos + 2 - data);
+                handler.cdata(event.value);
+                break;
+                
+            }
+            case EventType::Comment: {
+                
+                handler.comment(event.value);
+                break;
+                
+            }
+            case EventType::ProcessingInstruction: {
+                
+                handler.processingInstruction(event.name, event.value);
+                break;
+                
+            }
+                
+            }
+            
+        }
+        
+    }
+    template <Flag F, typename H>
+    void replay(const Chunk& chunk, const Event* first, const char* data, std::vector<StringView8>& stack, H& handler) const {
+        
+        replay<F>(first, chunk.events.data() + chunk.events.size(), data, stack, handler);
+        if(chunk.error) std::rethrow_exception(chunk.error);
+        
+    }
+    
+private:
+    
+    // Builds an XMLDocument, copying the values that are not in
+    // [begin, end) into it, since the chunks that decoded them are freed
+    class CopyingBuilder : public XMLDocument::Builder {
+        
+    private:
+        
+        XMLDocument* document;
+        const char* begin;
+        const char* end;
+        
+    private:
+        
+        StringView8 copy(StringView8 value) {
+            
+            if(value.getData() >= begin && value.getData() < end) return value;
+            auto data = static_cast<char*>(document->allocator.allocate(value.getLength()));
+            std::memcpy(data, value.getData(), value.getLength());
+            return StringView8(data, value.getLength());
+            
+        }
+        
+    public:
+        
+        CopyingBuilder(XMLDocument* document_, const char* begin_, const char* end_) :
+            XMLDocument::Builder(document_), document(document_), begin(begin_), end(end_) {}
+        
+        void attribute(StringView8 name, StringView8 value) { XMLDocument::Builder::attribute(name, copy(value)); }
+        void text(StringView8 value) { XMLDocument::Builder::text(copy(value)); }
+        
+    };
+    
+public:
+    
+    // threadCount is the number of worker threads, 0 for one per hardware
+    // thread. Chunks are about chunkSize bytes long.
+    XMLParallelParser(std::size_t threadCount_ = 0, std::size_t chunkSize_ = 1 << 20) :
+        threadCount(threadCount_ ? threadCount_ : std::max(std::thread::hardware_concurrency(), 1u)),
+        chunkSize(chunkSize_ ? chunkSize_ : 1), maxDepth(XMLParser::DefaultMaxDepth) {}
+    XMLParallelParser(const XMLParallelParser& src) = delete;
+    
+    std::size_t getThreadCount() const { return threadCount; }
+    std::size_t getChunkSize() const { return chunkSize; }
+    std::size_t getMaxDepth() const { return maxDepth; }
+    void setMaxDepth(std::size_t maxDepth_) { maxDepth = maxDepth_; }
+    
+    // Like XMLParser::parse with Flag::NonDestructive, the events reach the
+    // handler in document order on the calling thread. Values are only
+    // valid during the callback.
+    template <Flag F = Flag::Default, typename H>
+    void parse(const char* data, std::size_t length, H& handler) {
+        
+        using namespace Corecat::Util;
+        
+        assert(data || !length);
+        
+        constexpr Flag G = F | XMLParser::Bounded | Flag::NonDestructive;
+        const char* end = data + length;
+        
+        handler.startDocument();
+        
+        // BOM and XML declaration are parsed before splitting
+        XMLParser parser;
+        parser.s = const_cast<char*>(data);
+        parser.p = const_cast<char*>(data);
+        parser.e = const_cast<char*>(end);
+        if(parser.match<G>("\xEF\xBB\xBF")) parser.p += 3;
+        if(parser.match<G>("<?xml") && SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(parser.peek<G>(5))) {
+            
+            // "<?xml "
+            parser.p += 6;
+            parser.parseXMLDeclaration<G>(handler);
+            
+        }
+        
+        // Split at the first "<" after every chunkSize bytes, chunk i is
+        // [bounds[i], bounds[i + 1])
+        std::vector<const char*> bounds(1, parser.p);
+        while(static_cast<std::size_t>(end - bounds.back()) > chunkSize) {
+            
+            auto next = static_cast<const char*>(std::memchr(bounds.back() + chunkSize, '<', end - bounds.back() - chunkSize));
+            if(!next) break;
+            bounds.push_back(next);
+            
+        }
+        bounds.push_back(end);
+        
+        // Workers stay at most two chunks per thread ahead of the replay, so
+        // that memory use does not grow with the document. Chunk i is parsed
+        // in chunks[i % window].
+        const std::size_t count = bounds.size() - 1;
+        const std::size_t window = std::min(2 * threadCount, count);
+        std::unique_ptr<Chunk[]> chunks(new Chunk[window]);
+        Chunk fix;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::size_t taken = 0;
+        std::size_t replayed = 0;
+        bool stopped = false;
+        auto work = [&]() {
+            
+            while(true) {
+                
+                std::size_t i;
+                {
+                    
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [&]() { return stopped || taken == count || taken < replayed + window; });
+                    if(stopped || taken == count) return;
+                    i = taken++;
+                    chunks[i % window].reset(i, bounds[i], bounds[i + 1]);
+                    
+                }
+                parseChunk<F>(chunks[i % window], data, end);
+                {
+                    
+                    std::lock_guard<std::mutex> lock(mutex);
+                    chunks[i % window].done = true;
+                    
+                }
+                condition.notify_all();
+                
+            }
+            
+        };
+        std::vector<std::thread> threads;
+        auto join = [&]() {
+            
+            {
+                
+                std::lock_guard<std::mutex> lock(mutex);
+                stopped = true;
+                
+            }
+            condition.notify_all();
+            for(auto& thread : threads) thread.join();
+            
+        };
+        
+        std::vector<StringView8> stack;
+        const char* stop = parser.p;
+        try {
+            
+            for(std::size_t i = 0; i < std::min(threadCount, count); ++i) threads.emplace_back(work);
+            for(std::size_t i = 0; i < count; ++i) {
+                
+                auto& chunk = chunks[i % window];
+                {
+                    
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [&]() { return chunk.index == i && chunk.done; });
+                    
+                }
+                const Chunk* result = &chunk;
+                const Event* first = chunk.events.data();
+                if(chunk.begin != stop) {
+                    
+                    // The chunk began inside the last token of the chunk
+                    // before, so it is parsed again from where that ends
+                    // until it agrees with the first parse
+                    fix.reset(i, stop, chunk.end);
+                    first = parseChunk<F>(fix, data, end, &chunk.events);
+                    if(first) replay<F>(fix.events.data(), fix.events.data() + fix.events.size(), data, stack, handler);
+                    else { result = &fix; first = fix.events.data(); }
+                    
+                }
+                replay<F>(*result, first, data, stack, handler);
+                stop = result->stop;
+                const bool last = result->last;
+                {
+                    
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++replayed;
+                    
+                }
+                condition.notify_all();
+                if(last) break;
+                
+            }
+            
+        } catch(...) { join(); throw; }
+        join();
+        
+        if(!stack.empty()) throw XMLParseException("Unexpected end of data", stop - data);
+        handler.endDocument();
+        
+    }
+    template <Flag F = Flag::Default, typename H>
+    void parse(const char* data, H& handler) {
+        
+        assert(data);
+        
+        parse<F>(data, std::strlen(data), handler);
+        
+    }
+    // Parses into document. The data is never modified, and is referenced
+    // by the document like with Flag::NonDestructive.
+    template <Flag F = Flag::Default>
+    void parse(const char* data, std::size_t length, XMLDocument& document) {
+        
+        assert(data || !length);
+        
+        document.clear();
+        CopyingBuilder builder(&document, data, data + length);
+        parse<F>(data, length, builder);
+        
+    }
+    
+};
+
+}
+}
+}
+
+
+#endif
@@ -0,0 +1,301 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CATS_TEXTCAT_XML_PARALLELSERIALIZER_HPP
+#define CATS_TEXTCAT_XML_PARALLELSERIALIZER_HPP
+
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Cats/Corecat/Text/String.hpp"
+
+#include "Document.hpp"
+#include "Serializer.hpp"
+#include "Sink.hpp"
+
+
+namespace Cats {
+namespace Textcat{
+inline namespace XML {
+
+// Serializes a list of sibling nodes on several threads. The list is split
+// into chunks of consecutive nodes that are serialized into buffers of their
+// own, and the calling thread writes the buffers to the sink in order. At
+// most a few chunks per thread are kept in memory at once.
+class XMLParallelSerializer {
+    
+private:
+    
+    using StringView8 = Corecat::StringView8;
+    
+    struct Chunk {
+        
+        XMLNode* first;
+        XMLNode* last;
+        // Whether text comes before the chunk in the parent
+        bool text;
+        
+    };
+    struct Slot {
+        
+        std::string output;
+        // Start of the output of the chunk, after what was written only to
+        // bring the format into the right state
+        std::size_t offset;
+        bool done;
+        bool final;
+        
+    };
+    
+private:
+    
+    // Number of siblings in a chunk. The first chunks are small so that
+    // documents with a few large subtrees are still split.
+    static constexpr std::size_t MaxChunkSize = 256;
+    
+private:
+    
+    std::size_t threadCount;
+    
+private:
+    
+    static bool isText(XMLNode& node) { return node.getType() == XMLNodeType::Text || node.getType() == XMLNodeType::CDATA; }
+    
+    // Serializes the siblings from first to last. They are split into chunks
+    // as the chunks are taken, so no thread has to walk the whole list
+    // first. For chunk i, prefix(serializer, chunk, i) writes what comes
+    // before its nodes and suffix(serializer) what comes after the last
+    // chunk; prefix returns whether its output is part of the result.
+    template <typename Sink, typename Format, typename P, typename S>
+    void run(XMLNode& first, XMLNode& last, Sink& sink, const Format& format, P prefix, S suffix) const {
+        
+        const std::size_t window = threadCount * 2;
+        std::vector<Slot> slots(window);
+        XMLNode* node = &first;
+        bool text = false;
+        std::size_t size = 1;
+        std::size_t next = 0;
+        std::size_t written = 0;
+        bool stopped = false;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable condition;
+        
+        // Takes the next chunk; called with the lock held
+        auto take = [&]() {
+            
+            Chunk chunk = {node, node, text};
+            for(std::size_t i = 1; ; ++i) {
+                
+                text = text || isText(*chunk.last);
+                if(chunk.last == &last || i == size) break;
+                chunk.last = chunk.last->next;
+                
+            }
+            node = chunk.last == &last ? nullptr : chunk.last->next;
+            if(size < MaxChunkSize) size *= 2;
+            return chunk;
+            
+        };
+        auto serialize = [&](const Chunk& chunk, std::size_t i, bool final) {
+            
+            auto& slot = slots[i % window];
+            slot.output.clear();
+            BasicXMLSerializer<XMLStringSink, Format> serializer(XMLStringSink(slot.output), format);
+            slot.offset = prefix(serializer, chunk, i) ? 0 : serializer.getSink().getLength();
+            XMLDocument::visit(*chunk.first, *chunk.last, serializer);
+            if(final) suffix(serializer);
+            serializer.flush();
+            
+        };
+        // Serializes the next chunk if it is within the window; called and
+        // returns with the lock held
+        auto work = [&](std::unique_lock<std::mutex>& lock) {
+            
+            if(stopped || !node || next >= written + window) return false;
+            const std::size_t i = next++;
+            const Chunk chunk = take();
+            const bool final = !node;
+            slots[i % window].final = final;
+            lock.unlock();
+            try {
+                
+                serialize(chunk, i, final);
+                
+            } catch(...) {
+                
+                lock.lock();
+                if(!error) error = std::current_exception();
+                stopped = true;
+                condition.notify_all();
+                return true;
+                
+            }
+            lock.lock();
+            slots[i % window].done = true;
+            condition.notify_all();
+            return true;
+            
+        };
+        auto worker = [&]() {
+            
+            std::unique_lock<std::mutex> lock(mutex);
+            while(!stopped && node) if(!work(lock)) condition.wait(lock);
+            
+        };
+        
+        std::vector<std::thread> threads;
+        try {
+            
+            for(std::size_t i = 1; i < threadCount && &first != &last; ++i) threads.emplace_back(worker);
+            for(std::size_t i = 0; ; ++i) {
+                
+                auto& slot = slots[i % window];
+                {
+                    
+                    std::unique_lock<std::mutex> lock(mutex);
+                    while(!stopped && !slot.done) if(!work(lock)) condition.wait(lock);
+                    if(stopped) break;
+                    
+                }
+                sink.write(slot.output.data() + slot.offset, slot.output.size() - slot.offset);
+                if(slot.final) break;
+                {
+                    
+                    std::lock_guard<std::mutex> lock(mutex);
+                    slot.done = false;
+                    ++written;
+                    
+                }
+                condition.notify_all();
+                
+            }
+            
+        } catch(...) {
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!error) error = std::current_exception();
+            stopped = true;
+            
+        }
+        {
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+            
+        }
+        condition.notify_all();
+        for(auto& thread : threads) thread.join();
+        if(error) std::rethrow_exception(error);
+        sink.flush();
+        
+    }
+    
+public:
+    
+    // threadCount is the number of threads, 0 for one per hardware thread
+    XMLParallelSerializer(std::size_t threadCount_ = 0) :
+        threadCount(threadCount_ ? threadCount_ : std::max(std::thread::hardware_concurrency(), 1u)) {}
+    XMLParallelSerializer(const XMLParallelSerializer& src) = delete;
+    
+    std::size_t getThreadCount() const { return threadCount; }
+    
+    // Writes the same output as serializing the document with
+    // BasicXMLSerializer<Sink, Format>. The children of the root element are
+    // split among the threads.
+    template <typename Format = XMLCompactFormat, typename Sink>
+    void serialize(XMLDocument& document, Sink sink, Format format = Format()) const {
+        
+        XMLElement* root = nullptr;
+        for(auto& node : document.child()) if(node.getType() == XMLNodeType::Element) { root = &node.asElement(); break; }
+        if(!root || !root->hasChildNodes()) {
+            
+            BasicXMLSerializer<Sink, Format> serializer(std::move(sink), format);
+            document.visit(serializer);
+            return;
+            
+        }
+        
+        run(root->getFirstChild(), root->getLastChild(), sink, format, [&](BasicXMLSerializer<XMLStringSink, Format>& serializer, const Chunk& chunk, std::size_t i) {
+            
+            serializer.startDocument();
+            if(!i) {
+                
+                // The nodes before the root element and its start tag
+                if(root != &document.getFirstChild()) XMLDocument::visit(document.getFirstChild(), *root->prev, serializer);
+                serializer.startElement(root->getName());
+                for(auto& attr : root->attribute()) serializer.attribute(attr.getName(), attr.getValue());
+                serializer.endAttributes(false);
+                return true;
+                
+            }
+            // Writes nothing useful, but leaves the format in the state
+            // it has at the start of the chunk
+            serializer.comment(StringView8());
+            serializer.startElement(root->getName());
+            serializer.endAttributes(false);
+            if(chunk.text) serializer.text(StringView8());
+            return false;
+            
+        }, [&](BasicXMLSerializer<XMLStringSink, Format>& serializer) {
+            
+            serializer.endElement(root->getName());
+            if(root != &document.getLastChild()) XMLDocument::visit(*root->next, document.getLastChild(), serializer);
+            serializer.endDocument();
+            
+        });
+        
+    }
+    // Writes the siblings from first to last like XMLDocument::visit(first,
+    // last, serializer) would with a BasicXMLSerializer<Sink, Format>
+    template <typename Format = XMLCompactFormat, typename Sink>
+    void serialize(XMLNode& first, XMLNode& last, Sink sink, Format format = Format()) const {
+        
+        run(first, last, sink, format, [&](BasicXMLSerializer<XMLStringSink, Format>& serializer, const Chunk& /*chunk*/, std::size_t i) {
+            
+            if(!i) return true;
+            serializer.comment(StringView8());
+            return false;
+            
+        }, [&](BasicXMLSerializer<XMLStringSink, Format>& /*serializer*/) {});
+        
+    }
+    
+};
+
+}
+}
+}
+
+
+#endif
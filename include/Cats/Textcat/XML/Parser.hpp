@@ -34,9 +34,39 @@
 #include <algorithm>
 #include <exception>
 #include <limits>
+#include <type_traits>
+#include <vector>
 
+#include "Cats/Corecat/Data/Allocator/FastAllocator.hpp"
 #include "Cats/Corecat/Util/Sequence.hpp"
 
+// Reading past the null character within a page is harmless but trips
+// AddressSanitizer, so SIMD is turned off for sanitized builds.
+#if defined(__SANITIZE_ADDRESS__)
+#   define CATS_TEXTCAT_XML_NO_SIMD
+#elif defined(__has_feature)
+#   if __has_feature(address_sanitizer)
+#       define CATS_TEXTCAT_XML_NO_SIMD
+#   endif
+#endif
+#if !defined(CATS_TEXTCAT_XML_NO_SIMD)
+#   if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#       define CATS_TEXTCAT_XML_SSE2
+#       include <emmintrin.h>
+#   endif
+#   if defined(CATS_TEXTCAT_XML_SSE2) && defined(__SSE4_2__)
+#       define CATS_TEXTCAT_XML_SSE42
+#       include <nmmintrin.h>
+#   endif
+#   if defined(CATS_TEXTCAT_XML_SSE2) && defined(__AVX2__)
+#       define CATS_TEXTCAT_XML_AVX2
+#       include <immintrin.h>
+#   endif
+#   if defined(CATS_TEXTCAT_XML_SSE2) && defined(_MSC_VER)
+#       include <intrin.h>
+#   endif
+#endif
+
 
 namespace Cats {
 namespace Textcat{
@@ -59,16 +89,198 @@ struct Exclude {
 };
 
 
-template <typename Cond, typename = void>
-struct Skipper {
+template <typename Cond>
+struct ScalarSkipper {
     
-    static size_t skip(char*& p) {
+    static std::size_t skip(char*& p) {
         
         using namespace Corecat;
         
         auto t = p;
         while(SequenceTable<MapperSequence<Cond, IndexSequence<int, 0, 256>>>::get(*t)) ++t;
-        const size_t length = t - p;
+        const std::size_t length = t - p;
+        p = t;
+        return length;
+        
+    }
+    static std::size_t skip(char*& p, const char* e) {
+        
+        using namespace Corecat;
+        
+        auto t = p;
+        while(t != e && SequenceTable<MapperSequence<Cond, IndexSequence<int, 0, 256>>>::get(*t)) ++t;
+        const std::size_t length = t - p;
+        p = t;
+        return length;
+        
+    }
+    
+};
+
+#if defined(CATS_TEXTCAT_XML_SSE2)
+
+inline std::size_t countTrailingZero(std::uint32_t x) {
+    
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return index;
+#else
+    return __builtin_ctz(x);
+#endif
+    
+}
+
+// A matcher returns the index of the first byte in a block that stops the
+// skip, or blockSize if there is none.
+template <typename Cond>
+struct SSE2Matcher;
+
+template <unsigned char... V>
+struct SSE2Matcher<Exclude<unsigned char, V...>> {
+    
+    static constexpr std::size_t blockSize = 16;
+    
+    static std::size_t find(const char* t, bool aligned) {
+        
+        const __m128i x = aligned ? _mm_load_si128(reinterpret_cast<const __m128i*>(t))
+            : _mm_loadu_si128(reinterpret_cast<const __m128i*>(t));
+        __m128i m = _mm_setzero_si128();
+        const int dummy[] = {(m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8(static_cast<char>(V)))), 0)...};
+        (void)dummy;
+        const std::uint32_t mask = static_cast<std::uint32_t>(_mm_movemask_epi8(m));
+        return mask ? countTrailingZero(mask) : blockSize;
+        
+    }
+    
+};
+
+#if defined(CATS_TEXTCAT_XML_SSE42)
+
+// pcmpestri tests up to 16 characters at once, which beats a chain of
+// pcmpeqb once the class gets larger.
+template <typename Cond>
+struct SSE42Matcher;
+
+template <unsigned char... V>
+struct SSE42Matcher<Exclude<unsigned char, V...>> {
+    
+    static constexpr std::size_t blockSize = 16;
+    
+    static std::size_t find(const char* t, bool aligned) {
+        
+        alignas(16) static const char set[16] = {static_cast<char>(V)...};
+        const __m128i x = aligned ? _mm_load_si128(reinterpret_cast<const __m128i*>(t))
+            : _mm_loadu_si128(reinterpret_cast<const __m128i*>(t));
+        return _mm_cmpestri(_mm_load_si128(reinterpret_cast<const __m128i*>(set)), sizeof...(V), x, 16,
+            _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        
+    }
+    
+};
+
+#endif
+
+#if defined(CATS_TEXTCAT_XML_AVX2)
+
+template <typename Cond>
+struct AVX2Matcher;
+
+template <unsigned char... V>
+struct AVX2Matcher<Exclude<unsigned char, V...>> {
+    
+    static constexpr std::size_t blockSize = 32;
+    
+    static std::size_t find(const char* t, bool aligned) {
+        
+        const __m256i x = aligned ? _mm256_load_si256(reinterpret_cast<const __m256i*>(t))
+            : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(t));
+        __m256i m = _mm256_setzero_si256();
+        const int dummy[] = {(m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(static_cast<char>(V)))), 0)...};
+        (void)dummy;
+        const std::uint32_t mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(m));
+        return mask ? countTrailingZero(mask) : blockSize;
+        
+    }
+    
+};
+
+#endif
+
+template <typename Cond>
+struct SIMDMatcherSelector;
+
+template <typename T, T... V>
+struct SIMDMatcherSelector<Exclude<T, V...>> {
+    
+#if defined(CATS_TEXTCAT_XML_AVX2)
+    using Type = AVX2Matcher<Exclude<T, V...>>;
+#elif defined(CATS_TEXTCAT_XML_SSE42)
+    using Type = typename std::conditional<(sizeof...(V) > 4), SSE42Matcher<Exclude<T, V...>>, SSE2Matcher<Exclude<T, V...>>>::type;
+#else
+    using Type = SSE2Matcher<Exclude<T, V...>>;
+#endif
+    
+};
+
+template <typename Cond>
+struct SIMDSkipper {
+    
+    using Matcher = typename SIMDMatcherSelector<Cond>::Type;
+    
+    static constexpr std::uintptr_t pageSize = 4096;
+    
+    static std::size_t skip(char*& p) {
+        
+        // The input is only known to be terminated by a null character, so a
+        // block may be read past it only if the read cannot cross into
+        // another page. An unaligned block is tried first to keep short runs
+        // cheap, then the scan continues with aligned blocks.
+        auto t = p;
+        if((reinterpret_cast<std::uintptr_t>(t) & (pageSize - 1)) <= pageSize - Matcher::blockSize) {
+            
+            const std::size_t index = Matcher::find(t, false);
+            if(index != Matcher::blockSize) { p = t + index; return index; }
+            t = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(t) + Matcher::blockSize) & ~(Matcher::blockSize - 1));
+            
+        } else {
+            
+            using namespace Corecat;
+            
+            for(; reinterpret_cast<std::uintptr_t>(t) & (Matcher::blockSize - 1); ++t)
+                if(!SequenceTable<MapperSequence<Cond, IndexSequence<int, 0, 256>>>::get(*t)) {
+                    
+                    const std::size_t length = t - p;
+                    p = t;
+                    return length;
+                    
+                }
+            
+        }
+        while(true) {
+            
+            const std::size_t index = Matcher::find(t, true);
+            if(index != Matcher::blockSize) { t += index; break; }
+            t += Matcher::blockSize;
+            
+        }
+        const std::size_t length = t - p;
+        p = t;
+        return length;
+        
+    }
+    static std::size_t skip(char*& p, const char* e) {
+        
+        // The end is known, so blocks are read unaligned and never past it
+        auto t = p;
+        for(; static_cast<std::size_t>(e - t) >= Matcher::blockSize; t += Matcher::blockSize) {
+            
+            const std::size_t index = Matcher::find(t, false);
+            if(index != Matcher::blockSize) { t += index; break; }
+            
+        }
+        if(static_cast<std::size_t>(e - t) < Matcher::blockSize) ScalarSkipper<Cond>::skip(t, e);
+        const std::size_t length = t - p;
         p = t;
         return length;
         
@@ -76,6 +288,11 @@ struct Skipper {
     
 };
 
+#endif
+
+template <typename Cond, typename = void>
+struct Skipper : ScalarSkipper<Cond> {};
+
 
 using Space = Include<unsigned char, '\t', '\n', '\r', ' '>;
 using Name = Exclude<unsigned char, 0, '\t', '\n', '\r', ' ', '/', '>', '?'>;
@@ -88,6 +305,138 @@ using Text = Exclude<unsigned char, 0, '<'>;
 using TextNoSpace = Exclude<unsigned char, 0, '\t', '\n', '\r', ' ', '<'>;
 using TextNoRef = Exclude<unsigned char, 0, '&', '<'>;
 using TextNoSpaceRef = Exclude<unsigned char, 0, '\t', '\n', '\r', ' ', '&', '<'>;
+using Tag = Exclude<unsigned char, 0, '"', '\'', '>'>;
+
+#if defined(CATS_TEXTCAT_XML_SSE2)
+
+// Names and white space runs are usually only a few bytes long, where the
+// table lookup is faster than setting up a block compare, so only the
+// classes that scan text and attribute values use SIMD.
+template <> struct Skipper<AttributeValue1> : SIMDSkipper<AttributeValue1> {};
+template <> struct Skipper<AttributeValueNoRef1> : SIMDSkipper<AttributeValueNoRef1> {};
+template <> struct Skipper<AttributeValue2> : SIMDSkipper<AttributeValue2> {};
+template <> struct Skipper<AttributeValueNoRef2> : SIMDSkipper<AttributeValueNoRef2> {};
+template <> struct Skipper<Text> : SIMDSkipper<Text> {};
+template <> struct Skipper<TextNoSpace> : SIMDSkipper<TextNoSpace> {};
+template <> struct Skipper<TextNoRef> : SIMDSkipper<TextNoRef> {};
+template <> struct Skipper<TextNoSpaceRef> : SIMDSkipper<TextNoSpaceRef> {};
+template <> struct Skipper<Tag> : SIMDSkipper<Tag> {};
+
+#endif
+
+template <char... C>
+struct ScalarSearcher {
+    
+    static bool match(const char* t) {
+        
+        const char s[] = {C...};
+        for(std::size_t i = 0; i < sizeof...(C); ++i) if(t[i] != s[i]) return false;
+        return true;
+        
+    }
+    static bool match(const char* t, const char* e) {
+        
+        return static_cast<std::size_t>(e - t) >= sizeof...(C) && match(t);
+        
+    }
+    static void search(char*& p) {
+        
+        auto t = p;
+        while(*t && !match(t)) ++t;
+        p = t;
+        
+    }
+    static void search(char*& p, const char* e) {
+        
+        auto t = p;
+        while(t != e && *t && !match(t, e)) ++t;
+        p = t;
+        
+    }
+    
+};
+
+#if defined(CATS_TEXTCAT_XML_SSE2)
+
+// Looks for the first two characters of the terminator in 16 byte blocks
+// and verifies the rest for each candidate, so blocks without any candidate
+// (e.g. base64 in CDATA) cost two compares.
+template <char... C>
+struct SIMDSearcher {
+    
+    static constexpr std::size_t blockSize = 16;
+    
+    static void search(char*& p) {
+        
+        static_assert(sizeof...(C) >= 2, "Terminator is too short");
+        const char s[] = {C...};
+        
+        auto t = p;
+        for(; reinterpret_cast<std::uintptr_t>(t) & (blockSize - 1); ++t)
+            if(!*t || ScalarSearcher<C...>::match(t)) { p = t; return; }
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i c0 = _mm_set1_epi8(s[0]);
+        const __m128i c1 = _mm_set1_epi8(s[1]);
+        while(true) {
+            
+            const __m128i x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(t));
+            if(_mm_movemask_epi8(_mm_cmpeq_epi8(x0, zero))) break;
+            // No null character in this block, so t[blockSize] is readable
+            const __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + 1));
+            std::uint32_t mask = static_cast<std::uint32_t>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(x0, c0), _mm_cmpeq_epi8(x1, c1))));
+            for(; mask; mask &= mask - 1) {
+                
+                const auto candidate = t + countTrailingZero(mask);
+                if(ScalarSearcher<C...>::match(candidate)) { p = candidate; return; }
+                
+            }
+            t += blockSize;
+            
+        }
+        ScalarSearcher<C...>::search(t);
+        p = t;
+        
+    }
+    static void search(char*& p, const char* e) {
+        
+        const char s[] = {C...};
+        
+        auto t = p;
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i c0 = _mm_set1_epi8(s[0]);
+        const __m128i c1 = _mm_set1_epi8(s[1]);
+        for(; static_cast<std::size_t>(e - t) > blockSize; t += blockSize) {
+            
+            const __m128i x0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t));
+            if(_mm_movemask_epi8(_mm_cmpeq_epi8(x0, zero))) break;
+            const __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + 1));
+            std::uint32_t mask = static_cast<std::uint32_t>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(x0, c0), _mm_cmpeq_epi8(x1, c1))));
+            for(; mask; mask &= mask - 1) {
+                
+                const auto candidate = t + countTrailingZero(mask);
+                if(ScalarSearcher<C...>::match(candidate, e)) { p = candidate; return; }
+                
+            }
+            
+        }
+        ScalarSearcher<C...>::search(t, e);
+        p = t;
+        
+    }
+    
+};
+
+template <char... C>
+struct Searcher : SIMDSearcher<C...> {};
+
+#else
+
+template <char... C>
+struct Searcher : ScalarSearcher<C...> {};
+
+#endif
 
 struct Decimal {
     
@@ -131,6 +480,7 @@ class XMLParser {
 private:
     
     using StringView8 = Corecat::StringView8;
+    using FastAllocator = Corecat::FastAllocator<>;
     
 public:
     
@@ -141,10 +491,12 @@ public:
         NormalizeSpace = 0x00000002,
         EntityTranslation = 0x00000004,
         ClosingTagValidate = 0x00000008,
+        NonDestructive = 0x00000010,
         
         Default = TrimSpace | EntityTranslation,
         
     };
+    static constexpr std::size_t DefaultMaxDepth = 65536;
     friend constexpr bool operator &(Flag a, Flag b) {
         
         return static_cast<std::uint32_t>(a) & static_cast<std::uint32_t>(b);
@@ -156,30 +508,128 @@ public:
         
     }
     
+private:
+    
+    // Set internally when the data ends at e instead of a null character
+    static constexpr Flag Bounded = static_cast<Flag>(0x80000000);
+    // Set internally when text is scanned through a structural index
+    static constexpr Flag Indexed = static_cast<Flag>(0x40000000);
+    
+    // Drive the token parsers below on buffered input, one token at a time
+    // or on chunks of the data
+    template <typename H, Flag F>
+    friend class XMLPushParser;
+    template <Flag F>
+    friend class XMLReader;
+    friend class XMLParallelParser;
+    friend class XMLRecordParser;
+    friend class XMLStructuralIndex;
+    
 private:
     
     char* s;
     char* p;
+    char* e;
+    FastAllocator allocator;
+    FastAllocator* arena;
+    // Element types of the open elements
+    std::vector<StringView8> stack;
+    std::size_t maxDepth;
+    // Set by skipCurrentElement() during startElement()
+    bool skipping;
+    // Offsets of '<', '&' and null characters from s, with cursor at the
+    // first one that may still lie ahead of p
+    const std::uint32_t* cursor;
+    const std::uint32_t* indexEnd;
     
 private:
     
+    // Reads the character at p + i; the end of data reads as a null character.
+    template <Flag F>
+    char peek(std::size_t i = 0) const {
+        
+        return (F & Bounded) && static_cast<std::size_t>(e - p) <= i ? 0 : p[i];
+        
+    }
+    template <Flag F, std::size_t N>
+    bool match(const char (&str)[N]) const {
+        
+        if((F & Bounded) && static_cast<std::size_t>(e - p) < N - 1) return false;
+        for(std::size_t i = 0; i < N - 1; ++i) if(p[i] != str[i]) return false;
+        return true;
+        
+    }
+    template <Flag F>
+    bool match(StringView8 str) const {
+        
+        if((F & Bounded) && static_cast<std::size_t>(e - p) < str.getLength()) return false;
+        for(std::size_t i = 0; i < str.getLength(); ++i) if(p[i] != str.getData()[i]) return false;
+        return true;
+        
+    }
+    // Text stops at the next indexed position, except that a reference does
+    // not stop Impl::Text
+    template <typename Cond>
+    struct IsIndexed {
+        
+        static constexpr bool value = std::is_same<Cond, Impl::Text>::value || std::is_same<Cond, Impl::TextNoRef>::value;
+        
+    };
+    template <typename Cond>
+    std::size_t skipIndexed(char*& t, const std::uint32_t*& c) const {
+        
+        const auto begin = t;
+        while(c != indexEnd && s + *c < t) ++c;
+        if(std::is_same<Cond, Impl::Text>::value) while(c != indexEnd && s[*c] == '&') ++c;
+        t = c != indexEnd ? s + *c : e;
+        return t - begin;
+        
+    }
+    template <Flag F, typename Cond>
+    std::size_t skip(char*& t) const {
+        
+        if((F & Indexed) && IsIndexed<Cond>::value) { auto c = cursor; return skipIndexed<Cond>(t, c); }
+        return (F & Bounded) ? Impl::Skipper<Cond>::skip(t, e) : Impl::Skipper<Cond>::skip(t);
+        
+    }
+    template <Flag F, typename Cond>
+    std::size_t skip() {
+        
+        if((F & Indexed) && IsIndexed<Cond>::value) return skipIndexed<Cond>(p, cursor);
+        return skip<F, Cond>(p);
+        
+    }
+    template <Flag F, char... C>
+    void search() {
+        
+        if(F & Bounded) Impl::Searcher<C...>::search(p, e);
+        else Impl::Searcher<C...>::search(p);
+        
+    }
+    void clearArena() {
+        
+        // An external arena belongs to its owner, e.g. XMLDocument
+        if(arena == &allocator) allocator.clear();
+        
+    }
+    
     template <Flag F>
     void parseReference(char*& q) {
         
         using namespace Corecat::Util;
         
-        switch(p[1]) {
+        switch(peek<F>(1)) {
         
         case 0: throw XMLParseException("Unexpected end of data", p - s);
         case '#': {
             
-            if(p[2] == 'x') {
+            if(peek<F>(2) == 'x') {
                 
                 p += 3;
-                if(*p == ';') throw XMLParseException("Unexpected ;", p - s);
+                if(peek<F>() == ';') throw XMLParseException("Unexpected ;", p - s);
                 std::uint32_t code = 0;
-                for(unsigned char t; (t = SequenceTable<MapperSequence<Impl::Hexadecimal, IndexSequence<int, 0, 256>>>::get(*p)) != 255; code = code * 16 + t, ++p);
-                if(*p != ';') throw XMLParseException("Expected ;", p - s);
+                for(unsigned char t; (t = SequenceTable<MapperSequence<Impl::Hexadecimal, IndexSequence<int, 0, 256>>>::get(peek<F>())) != 255; code = code * 16 + t, ++p);
+                if(peek<F>() != ';') throw XMLParseException("Expected ;", p - s);
                 ++p;
                 // TODO: Code conversion
                 *q = code;
@@ -188,10 +638,10 @@ private:
             } else {
                 
                 p += 2;
-                if(*p == ';') throw XMLParseException("Unexpected ;", p - s);
+                if(peek<F>() == ';') throw XMLParseException("Unexpected ;", p - s);
                 std::uint32_t code = 0;
-                for(unsigned char t; (t = SequenceTable<MapperSequence<Impl::Decimal, IndexSequence<int, 0, 256>>>::get(*p)) != 255; code = code * 10 + t, ++p);
-                if(*p != ';') throw XMLParseException("Expected ;", p - s);
+                for(unsigned char t; (t = SequenceTable<MapperSequence<Impl::Decimal, IndexSequence<int, 0, 256>>>::get(peek<F>())) != 255; code = code * 10 + t, ++p);
+                if(peek<F>() != ';') throw XMLParseException("Expected ;", p - s);
                 ++p;
                 // TODO: Code conversion
                 *q = code;
@@ -203,7 +653,7 @@ private:
         }
         case 'a': {
             
-            if(p[2] == 'm' && p[3] == 'p' && p[4] == ';') {
+            if(match<F>("&amp;")) {
                 
                 // amp
                 p += 5;
@@ -212,7 +662,7 @@ private:
                 return;
                 
             }
-            if(p[2] == 'p' && p[3] == 'o' && p[4] == 's' && p[5] == ';') {
+            if(match<F>("&apos;")) {
                 
                 // apos
                 p += 6;
@@ -226,7 +676,7 @@ private:
         }
         case 'g': {
             
-            if(p[2] == 't' && p[3] == ';') {
+            if(match<F>("&gt;")) {
                 
                 // gt
                 p += 4;
@@ -240,7 +690,7 @@ private:
         }
         case 'l': {
             
-            if(p[2] == 't' && p[3] == ';') {
+            if(match<F>("&lt;")) {
                 
                 // lt
                 p += 4;
@@ -254,7 +704,7 @@ private:
         }
         case 'q': {
             
-            if(p[2] == 'u' && p[3] == 'o' && p[4] == 't' && p[5] == ';') {
+            if(match<F>("&quot;")) {
                 
                 // quot
                 p += 6;
@@ -276,96 +726,67 @@ private:
         throw XMLParseException("Invalid reference", p - s);
         
     }
-    template <Flag F, typename H>
-    void parseXMLDeclaration(H& /*handler*/) {
-        
-        using namespace Corecat::Util;
-        
-        Impl::Skipper<Impl::Space>::skip(p);
+    template <Flag F>
+    void parseDeclarationValue() {
         
-        // Parse "version"
-        if(p[0] != 'v' || p[1] != 'e' || p[2] != 'r' || p[3] != 's' || p[4] != 'i' || p[5] != 'o' || p[6] != 'n')
-            throw XMLParseException("Expected version", p - s);
-        p += 7;
-        Impl::Skipper<Impl::Space>::skip(p);
-        if(*p != '=') throw XMLParseException("Expected =", p - s);
+        skip<F, Impl::Space>();
+        if(peek<F>() != '=') throw XMLParseException("Expected =", p - s);
         ++p;
-        Impl::Skipper<Impl::Space>::skip(p);
-        if(*p == '"') {
+        skip<F, Impl::Space>();
+        if(peek<F>() == '"') {
             
             ++p;
-            Impl::Skipper<Impl::AttributeValue1>::skip(p);
-            if(*p != '"') throw XMLParseException("Expected \"", p - s);
-
-        } else if(*p == '\'') {
+            skip<F, Impl::AttributeValue1>();
+            if(peek<F>() != '"') throw XMLParseException("Expected \"", p - s);
+            
+        } else if(peek<F>() == '\'') {
             
             ++p;
-            Impl::Skipper<Impl::AttributeValue2>::skip(p);
-            if(*p != '\'') throw XMLParseException("Expected '", p - s);
+            skip<F, Impl::AttributeValue2>();
+            if(peek<F>() != '\'') throw XMLParseException("Expected '", p - s);
             
         } else throw XMLParseException("Expected \" or '", p - s);
         ++p;
         
-        if(*p != '?' && !SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(*p))
+    }
+    template <Flag F, typename H>
+    void parseXMLDeclaration(H& /*handler*/) {
+        
+        using namespace Corecat::Util;
+        
+        skip<F, Impl::Space>();
+        
+        // Parse "version"
+        if(!match<F>("version")) throw XMLParseException("Expected version", p - s);
+        p += 7;
+        parseDeclarationValue<F>();
+        
+        if(peek<F>() != '?' && !SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(peek<F>()))
             throw XMLParseException("Unexpected character", p - s);
-        Impl::Skipper<Impl::Space>::skip(p);
+        skip<F, Impl::Space>();
         
         // Parse "encoding"
-        if(p[0] == 'e' && p[1] == 'n' && p[2] == 'c' && p[3] == 'o' && p[4] == 'd' && p[5] == 'i' && p[6] == 'n' && p[7] == 'g') {
+        if(match<F>("encoding")) {
             
             p += 8;
-            Impl::Skipper<Impl::Space>::skip(p);
-            if(*p != '=') throw XMLParseException("Expected =", p - s);
-            ++p;
-            Impl::Skipper<Impl::Space>::skip(p);
-            if(*p == '"') {
-                
-                ++p;
-                Impl::Skipper<Impl::AttributeValue1>::skip(p);
-                if(*p != '"') throw XMLParseException("Expected \"", p - s);
-    
-            } else if(*p == '\'') {
-                
-                ++p;
-                Impl::Skipper<Impl::AttributeValue2>::skip(p);
-                if(*p != '\'') throw XMLParseException("Expected '", p - s);
-                
-            } else throw XMLParseException("Expected \" or '", p - s);
-            ++p;
+            parseDeclarationValue<F>();
             
         }
         
-        if(*p != '?' && !SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(*p))
+        if(peek<F>() != '?' && !SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(peek<F>()))
             throw XMLParseException("Unexpected character", p - s);
-        Impl::Skipper<Impl::Space>::skip(p);
+        skip<F, Impl::Space>();
         
         // Parse "standalone"
-        if(p[0] == 's' && p[1] == 't' && p[2] == 'a' && p[3] == 'n' && p[4] == 'd' && p[5] == 'a' && p[6] == 'l' && p[7] == 'o' && p[8] == 'n' && p[9] == 'e') {
+        if(match<F>("standalone")) {
             
             p += 10;
-            Impl::Skipper<Impl::Space>::skip(p);
-            if(*p != '=') throw XMLParseException("Expected =", p - s);
-            ++p;
-            Impl::Skipper<Impl::Space>::skip(p);
-            if(*p == '"') {
-                
-                ++p;
-                Impl::Skipper<Impl::AttributeValue1>::skip(p);
-                if(*p != '"') throw XMLParseException("Expected \"", p - s);
-    
-            } else if(*p == '\'') {
-                
-                ++p;
-                Impl::Skipper<Impl::AttributeValue2>::skip(p);
-                if(*p != '\'') throw XMLParseException("Expected '", p - s);
-                
-            } else throw XMLParseException("Expected \" or '", p - s);
-            ++p;
+            parseDeclarationValue<F>();
             
         }
         
-        Impl::Skipper<Impl::Space>::skip(p);
-        if(p[0] != '?' || p[1] != '>') throw XMLParseException("Expected ?>", p - s);
+        skip<F, Impl::Space>();
+        if(!match<F>("?>")) throw XMLParseException("Expected ?>", p - s);
         p += 2;
         
     }
@@ -380,8 +801,8 @@ private:
         
         StringView8 comment(p, 1);
         // Until "-->"
-        while(*p && (p[0] != '-' || p[1] != '-' || p[2] != '>')) ++p;
-        if(!*p) throw XMLParseException("Unexpected end of data", p - s);
+        search<F, '-', '-', '>'>();
+        if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
         comment.setLength(p - comment.getData());
         p += 3;
         handler.comment(comment);
@@ -391,15 +812,15 @@ private:
     void parseProcessingInstruction(H& handler) {
         
         StringView8 target(p, 1);
-        target.setLength(Impl::Skipper<Impl::Name>::skip(p));
+        target.setLength(skip<F, Impl::Name>());
         if(!target.getLength()) throw XMLParseException("Expected PI target", p - s);
-        if((p[0] != '?' || p[1] != '>') && !Impl::Skipper<Impl::Space>::skip(p))
+        if(!match<F>("?>") && !skip<F, Impl::Space>())
             throw XMLParseException("Expected white space", p - s);
         
         StringView8 content(p, 1);
         // Until "?>"
-        while(*p && (p[0] != '?' || p[1] != '>')) ++p;
-        if(!*p) throw XMLParseException("Unexpected end of data", p - s);
+        search<F, '?', '>'>();
+        if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
         content.setLength(p - content.getData());
         p += 2;
         
@@ -411,119 +832,317 @@ private:
         
         StringView8 text(p, 1);
         // Until "]]>"
-        while(*p && (p[0] != ']' || p[1] != ']' || p[2] != '>')) ++p;
-        if(!*p) throw XMLParseException("Unexpected end of data", p - s);
+        search<F, ']', ']', '>'>();
+        if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
         text.setLength(p - text.getData());
         p += 3;
         handler.cdata(text);
         
+    }
+    // Called before the decoded value first differs from the data, with q as
+    // its current end and r as the start of the rest of the raw value. In
+    // place parsing just keeps writing through q, while non-destructive
+    // parsing copies the value decoded so far into the arena and continues
+    // there. Cond must match the rest of the raw value, whose length bounds
+    // the decoded one.
+    template <Flag F, typename Cond>
+    char* materialize(StringView8& value, char* q, char* r, bool& copied) {
+        
+        if(!(F & Flag::NonDestructive) || copied) return q;
+        auto t = r;
+        skip<F, Cond>(t);
+        const std::size_t prefix = q - value.getData();
+        auto buffer = static_cast<char*>(arena->allocate(prefix + (t - r)));
+        std::copy(value.getData(), value.getData() + prefix, buffer);
+        value.setData(buffer, prefix);
+        copied = true;
+        return buffer + prefix;
+        
+    }
+    template <Flag F, typename ValueCond, typename NoRefCond>
+    StringView8 parseAttributeValue() {
+        
+        ++p;
+        StringView8 value(p, 0);
+        if(F & Flag::EntityTranslation) {
+            
+            auto q = p;
+            bool copied = false;
+            while(true) {
+                
+                auto len = skip<F, NoRefCond>();
+                if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+                if(p != q + len) std::copy(p - len, p, q);
+                q += len;
+                if(*p == '&') { q = materialize<F, ValueCond>(value, q, p, copied); parseReference<F>(q); }
+                else break;
+                
+            }
+            value.setLength(q - value.getData());
+            
+        } else {
+            
+            value.setLength(skip<F, ValueCond>());
+            if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+            
+        }
+        ++p;
+        return value;
+        
     }
     template <Flag F, typename H>
-    void parseElement(H& handler) {
+    void parseText(H& handler) {
+        
+        using namespace Corecat::Util;
+        
+        StringView8 text(p, 1);
+        auto q = p;
+        bool copied = false;
+        if(F & Flag::EntityTranslation) {
+            
+            if(F & Flag::NormalizeSpace) {
+                
+                while(true) {
+                    
+                    auto len = skip<F, Impl::TextNoSpaceRef>();
+                    if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+                    if(p != q + len) std::copy(p - len, p, q);
+                    q += len;
+                    if(*p == '&') { q = materialize<F, Impl::Text>(text, q, p, copied); parseReference<F>(q); }
+                    else if(*p != '<') {
+                        
+                        // A single space, or a run at the end starting with
+                        // one, reads the same after normalization
+                        auto w = p;
+                        if((skip<F, Impl::Space>() != 1 && peek<F>() != '<') || *w != ' ')
+                            q = materialize<F, Impl::Text>(text, q, w, copied);
+                        if(!(F & Flag::NonDestructive) || copied) *q = ' ';
+                        ++q;
+                        
+                    }
+                    else break;
+                    
+                }
+                
+            } else {
+                
+                while(true) {
+                    
+                    auto len = skip<F, Impl::TextNoRef>();
+                    if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+                    if(p != q + len) std::copy(p - len, p, q);
+                    q += len;
+                    if(*p == '&') { q = materialize<F, Impl::Text>(text, q, p, copied); parseReference<F>(q); }
+                    else break;
+                    
+                }
+                
+            }
+            
+        } else {
+            
+            if(F & Flag::NormalizeSpace) {
+                
+                while(true) {
+                    
+                    auto len = skip<F, Impl::TextNoSpace>();
+                    if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+                    if(p != q + len) std::copy(p - len, p, q);
+                    q += len;
+                    if(*p != '<') {
+                        
+                        auto w = p;
+                        if((skip<F, Impl::Space>() != 1 && peek<F>() != '<') || *w != ' ')
+                            q = materialize<F, Impl::Text>(text, q, w, copied);
+                        if(!(F & Flag::NonDestructive) || copied) *q = ' ';
+                        ++q;
+                        
+                    }
+                    else break;
+                    
+                }
+                
+            } else {
+                
+                skip<F, Impl::Text>();
+                if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+                q = p;
+                
+            }
+            
+        }
+        if(F & Flag::TrimSpace)
+            while(q != text.getData() && SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(q[-1])) --q;
+        text.setLength(q - text.getData());
+        handler.text(text);
+        
+    }
+    // Skips the rest of a start tag, returns whether the element is empty
+    template <Flag F>
+    bool skipTag() {
+        
+        while(true) {
+            
+            skip<F, Impl::Tag>();
+            if(peek<F>() == '"') {
+                
+                ++p;
+                skip<F, Impl::AttributeValue1>();
+                if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+                ++p;
+                
+            } else if(peek<F>() == '\'') {
+                
+                ++p;
+                skip<F, Impl::AttributeValue2>();
+                if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+                ++p;
+                
+            } else if(peek<F>() == '>') {
+                
+                ++p;
+                return p[-2] == '/';
+                
+            } else throw XMLParseException("Unexpected end of data", p - s);
+            
+        }
+        
+    }
+    // Skips the content and the end tag of an element. Only markup
+    // boundaries and the nesting depth are tracked: nothing is decoded or
+    // reported, and end tags are not matched against start tags.
+    template <Flag F>
+    void skipContent() {
+        
+        std::size_t depth = 1;
+        while(true) {
+            
+            skip<F, Impl::Text>();
+            if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+            
+            ++p;
+            switch(peek<F>()) {
+            
+            case '!': {
+                
+                ++p;
+                if(match<F>("--")) {
+                    
+                    p += 2;
+                    search<F, '-', '-', '>'>();
+                    if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+                    p += 3;
+                    
+                } else if(match<F>("[CDATA[")) {
+                    
+                    p += 7;
+                    search<F, ']', ']', '>'>();
+                    if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+                    p += 3;
+                    
+                } else throw XMLParseException("Unexpected character", p - s);
+                break;
+                
+            }
+            case '/': {
+                
+                ++p;
+                skipTag<F>();
+                if(!--depth) return;
+                break;
+                
+            }
+            case '?': {
+                
+                ++p;
+                search<F, '?', '>'>();
+                if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
+                p += 2;
+                break;
+                
+            }
+            default: {
+                
+                if(!skipTag<F>()) ++depth;
+                break;
+                
+            }
+                
+            }
+            
+        }
+        
+    }
+    // Finishes an element whose skipping was requested in startElement()
+    template <Flag F, typename H>
+    bool skipElement(H& handler, StringView8 name, bool empty) {
+        
+        skipping = false;
+        if(!empty) skipContent<F>();
+        handler.endElement(name);
+        return true;
+        
+    }
+    // Parses a start tag after "<", returns whether the element is empty or
+    // skipped, i.e. has no content left to parse
+    template <Flag F, typename H>
+    bool parseStartTag(H& handler, StringView8& name) {
         
         using namespace Corecat::Util;
         
         // Parse element type
-        StringView8 name(p, 1);
-        name.setLength(Impl::Skipper<Impl::Name>::skip(p));
+        name.setData(p, 1);
+        name.setLength(skip<F, Impl::Name>());
         if(!name.getLength()) throw XMLParseException("Expected element type", p - s);
         bool empty = false;
-        if(*p == '>') {
+        if(peek<F>() == '>') {
             
             ++p;
             handler.startElement(name);
+            if(skipping) return skipElement<F>(handler, name, false);
             
-        } else if(*p == '/') {
+        } else if(peek<F>() == '/') {
             
-            if(p[1] != '>') throw XMLParseException("eExpected >", p + 1 - s);
+            if(peek<F>(1) != '>') throw XMLParseException("eExpected >", p + 1 - s);
             p += 2;
             handler.startElement(name);
+            if(skipping) return skipElement<F>(handler, name, true);
             empty = true;
             
         } else {
             
+            if(!peek<F>()) throw XMLParseException("Unexpected end of data", p - s);
             ++p;
             handler.startElement(name);
-            Impl::Skipper<Impl::Space>::skip(p);
-            while(SequenceTable<MapperSequence<Impl::AttributeName, IndexSequence<int, 0, 256>>>::get(*p)) {
+            if(skipping) return skipElement<F>(handler, name, skipTag<F>());
+            skip<F, Impl::Space>();
+            while(SequenceTable<MapperSequence<Impl::AttributeName, IndexSequence<int, 0, 256>>>::get(peek<F>())) {
                 
                 // Parse attribute name
                 StringView8 name(p, 1);
-                name.setLength(Impl::Skipper<Impl::AttributeName>::skip(p));
+                name.setLength(skip<F, Impl::AttributeName>());
                 if(!name.getLength()) throw XMLParseException("Expected attribute name", p - s);
-                Impl::Skipper<Impl::Space>::skip(p);
-                if(*p != '=') throw XMLParseException("Expected =", p - s);
+                skip<F, Impl::Space>();
+                if(peek<F>() != '=') throw XMLParseException("Expected =", p - s);
                 ++p;
-                Impl::Skipper<Impl::Space>::skip(p);
+                skip<F, Impl::Space>();
                 
                 // Parse attribute value
                 StringView8 value;
-                if(*p == '"') {
-                    
-                    ++p;
-                    value.setData(p, 0);
-                    if(F & Flag::EntityTranslation) {
-                        
-                        auto q = p;
-                        while(true) {
-                            
-                            auto len = Impl::Skipper<Impl::AttributeValueNoRef1>::skip(p);
-                            if(*p == 0) throw XMLParseException("Unexpected end of data", p - s);
-                            if(p != q + len) std::copy(q, q + len, p - len);
-                            q += len;
-                            if(*p == '&') parseReference<F>(q);
-                            else break;
-                            
-                        }
-                        value.setLength(q - value.getData());
-                        
-                    } else {
-                        
-                        value.setLength(Impl::Skipper<Impl::AttributeValue1>::skip(p));
-                        if(*p == 0) throw XMLParseException("Unexpected end of data", p - s);
-                        
-                    }
-                    ++p;
-                    
-                } else if(*p == '\'') {
-                    
-                    ++p;
-                    value.setData(p, 0);
-                    if(F & Flag::EntityTranslation) {
-                        
-                        auto q = p;
-                        while(true) {
-                            
-                            auto len = Impl::Skipper<Impl::AttributeValueNoRef2>::skip(p);
-                            if(*p == 0) throw XMLParseException("Unexpected end of data", p - s);
-                            if(p != q + len) std::copy(q, q + len, p - len);
-                            q += len;
-                            if(*p == '&') parseReference<F>(q);
-                            else break;
-                            
-                        }
-                        value.setLength(q - value.getData());
-                        
-                    } else {
-                        
-                        value.setLength(Impl::Skipper<Impl::AttributeValue2>::skip(p));
-                        if(*p == 0) throw XMLParseException("Unexpected end of data", p - s);
-                        
-                    }
-                    ++p;
-                    
-                } else throw XMLParseException("Expected \" or '", p - s);
+                if(peek<F>() == '"') value = parseAttributeValue<F, Impl::AttributeValue1, Impl::AttributeValueNoRef1>();
+                else if(peek<F>() == '\'') value = parseAttributeValue<F, Impl::AttributeValue2, Impl::AttributeValueNoRef2>();
+                else throw XMLParseException("Expected \" or '", p - s);
                 handler.attribute(name, value);
-                Impl::Skipper<Impl::Space>::skip(p);
+                skip<F, Impl::Space>();
                 
             }
-            if(*p == '>') {
+            if(peek<F>() == '>') {
                 
                 ++p;
                 
-            } else if(*p == '/') {
+            } else if(peek<F>() == '/') {
                 
-                if(p[1] != '>') throw XMLParseException("Expected >", p + 1 - s);
+                if(peek<F>(1) != '>') throw XMLParseException("Expected >", p + 1 - s);
                 p += 2;
                 empty = true;
                 
@@ -531,197 +1150,121 @@ private:
             
         }
         handler.endAttributes(empty);
-        if(!empty) {
+        return empty;
+        
+    }
+    // Parses an end tag after "</", name is the element type of the start tag
+    template <Flag F, typename H>
+    void parseEndTag(H& handler, StringView8 name) {
+        
+        if(F & Flag::ClosingTagValidate) {
+            
+            StringView8 endName(p, 1);
+            skip<F, Impl::Name>();
+            endName.setLength(p - endName.getData());
+            skip<F, Impl::Space>();
+            if(peek<F>() != '>') throw XMLParseException("Expected >", p - s);
+            ++p;
+            handler.endElement(endName);
+            
+        } else {
+            
+            if(!match<F>(name)) throw XMLParseException("Unmatch element type", p - s);
+            StringView8 endName(p, name.getLength());
+            p += name.getLength();
+            skip<F, Impl::Space>();
+            if(peek<F>() != '>') throw XMLParseException("Expected >", p - s);
+            ++p;
+            handler.endElement(endName);
+            
+        }
+        
+    }
+    // Checked before each start tag, so a document nested too deeply fails
+    // before its stack grows any further
+    void checkDepth(std::size_t depth) const {
+        
+        if(depth >= maxDepth) throw XMLParseException("Element nesting too deep", p - s);
+        
+    }
+    // Parses an element after "<". The open elements are kept on stack rather
+    // than on the call stack, so deep nesting costs no native stack space.
+    template <Flag F, typename H>
+    void parseElement(H& handler) {
+        
+        StringView8 name;
+        stack.clear();
+        checkDepth(0);
+        if(parseStartTag<F>(handler, name)) return;
+        stack.push_back(name);
+        
+        while(true) {
+            
+            // Parse text
+            if(F & Flag::TrimSpace) skip<F, Impl::Space>();
+            if(peek<F>() != '<') parseText<F>(handler);
             
-            bool c = true;
-            do {
+            ++p;
+            switch(peek<F>()) {
                 
-                // Parse text
-                if(F & Flag::TrimSpace) Impl::Skipper<Impl::Space>::skip(p);
-                if(*p != '<') {
-                    
-                    if(F & Flag::EntityTranslation) {
-                        
-                        if(F & Flag::NormalizeSpace) {
-                            
-                            StringView8 text(p, 1);
-                            auto q = p;
-                            while(true) {
-                                
-                                auto len = Impl::Skipper<Impl::TextNoSpaceRef>::skip(p);
-                                if(*p == 0) throw XMLParseException("Unexpected end of data", p - s);
-                                if(p != q + len) std::copy(p - len, p, q);
-                                q += len;
-                                if(*p == '&') parseReference<F>(q);
-                                else if(*p != '<') { Impl::Skipper<Impl::Space>::skip(p); *(q++) = ' '; }
-                                else break;
-                                
-                            }
-                            if(F & Flag::TrimSpace && q[-1] == ' ') --q;
-                            text.setLength(q - text.getData());
-                            handler.text(text);
-                            
-                        } else {
-                            
-                            StringView8 text(p, 1);
-                            auto q = p;
-                            while(true) {
-                                
-                                auto len = Impl::Skipper<Impl::TextNoRef>::skip(p);
-                                if(*p == 0) throw XMLParseException("Unexpected end of data", p - s);
-                                if(p != q + len) std::copy(p - len, p, q);
-                                q += len;
-                                if(*p == '&') parseReference<F>(q);
-                                else break;
-                                
-                            }
-                            --q;
-                            if(F & Flag::TrimSpace)
-                                for(; SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(*q); --q);
-                            ++q;
-                            text.setLength(q - text.getData());
-                            handler.text(text);
-                            
-                        }
-                        
-                    } else {
-                        
-                        if(F & Flag::NormalizeSpace) {
-                            
-                            StringView8 text(p, 1);
-                            auto q = p;
-                            while(true) {
-                                
-                                auto len = Impl::Skipper<Impl::TextNoSpace>::skip(p);
-                                if(*p == 0) throw XMLParseException("Unexpected end of data", p - s);
-                                if(p != q + len) std::copy(p - len, p, q);
-                                q += len;
-                                if(*p != '<') { Impl::Skipper<Impl::Space>::skip(p); *(q++) = ' '; }
-                                else break;
-                                
-                            }
-                            --q;
-                            if(F & Flag::TrimSpace)
-                                for(; SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(*q); --q);
-                            ++q;
-                            text.setLength(q - text.getData());
-                            handler.text(text);
-                            
-                        } else {
-                            
-                            StringView8 text(p, 1);
-                            Impl::Skipper<Impl::Text>::skip(p);
-                            if(*p == 0) throw XMLParseException("Unexpected end of data", p - s);
-                            auto q = p - 1;
-                            if(F & Flag::TrimSpace)
-                                for(; SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(*q); --q);
-                            ++q;
-                            text.setLength(q - text.getData());
-                            handler.text(text);
-                            
-                        }
-                        
-                    }
-                    
-                }
+            case '!': {
                 
                 ++p;
-                switch(*p) {
-                    
-                case '!': {
-                    
-                    ++p;
-                    if(p[0] == '-' && p[1] == '-') {
-                        
-                        p += 2;
-                        parseComment<F>(handler);
-                        
-                    } else if(p[0] == '[' && p[1] == 'C' && p[2] == 'D' && p[3] == 'A' && p[4] == 'T' && p[5] == 'A' && p[6] == '[') {
-                        
-                        // "[CDATA["
-                        p += 7;
-                        parseCDATA<F>(handler);
-                        
-                    } else throw XMLParseException("Unexpected character", p - s);
-                    break;
+                if(match<F>("--")) {
                     
-                }
-                case '/': {
-                    
-                    ++p;
-                    if(F & Flag::ClosingTagValidate) {
+                    p += 2;
+                    parseComment<F>(handler);
                     
-                        StringView8 endName(p, 1);
-                        Impl::Skipper<Impl::Name>::skip(p);
-                        endName.setLength(p - endName.getData());
-                        Impl::Skipper<Impl::Space>::skip(p);
-                        if(*p != '>') throw XMLParseException("Expected >", p - s);
-                        ++p;
-                        handler.endElement(endName);
-                        
-                    } else {
-                        
-                        StringView8 endName(p, name.getLength());
-                        if(endName != name) throw XMLParseException("Unmatch element type", p - s);
-                        p += name.getLength();
-                        Impl::Skipper<Impl::Space>::skip(p);
-                        if(*p != '>') throw XMLParseException("Expected >", p - s);
-                        ++p;
-                        handler.endElement(endName);
-                        
-                    }
-                    c = false;
-                    break;
+                } else if(match<F>("[CDATA[")) {
                     
-                }
-                case '?': {
-                    
-                    ++p;
-                    parseProcessingInstruction<F>(handler);
-                    break;
-                    
-                }
-                default: {
-                    
-                    parseElement<F>(handler);
-                    break;
+                    p += 7;
+                    parseCDATA<F>(handler);
                     
-                }
+                } else throw XMLParseException("Unexpected character", p - s);
+                break;
                 
-                }
+            }
+            case '/': {
+                
+                ++p;
+                parseEndTag<F>(handler, stack.back());
+                stack.pop_back();
+                if(stack.empty()) return;
+                break;
+                
+            }
+            case '?': {
                 
-            } while(c);
+                ++p;
+                parseProcessingInstruction<F>(handler);
+                break;
+                
+            }
+            default: {
+                
+                checkDepth(stack.size());
+                if(!parseStartTag<F>(handler, name)) stack.push_back(name);
+                break;
+                
+            }
+            
+            }
             
         }
         
     }
-    
-public:
-    
-    XMLParser() = default;
-    
-    template <Flag F = Flag::Default, typename H>
-    void parse(char* data, H& handler) {
+    template <Flag F, typename H>
+    void parseDocument(H& handler) {
         
         using namespace Corecat::Util;
         
-        assert(data);
-        
-        s = data;
-        p = data;
         handler.startDocument();
         
         // Parse BOM
-        if(static_cast<unsigned char>(p[0]) == 0xEF &&
-            static_cast<unsigned char>(p[1]) == 0xBB &&
-            static_cast<unsigned char>(p[2]) == 0xBF) {
-            
-            p += 3;
-            
-        }
+        if(match<F>("\xEF\xBB\xBF")) p += 3;
         
         // Parse XML declaration
-        if(p[0] == '<' && p[1] == '?' && p[2] == 'x' && p[3] == 'm' && p[4] == 'l' && SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(p[5])) {
+        if(match<F>("<?xml") && SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(peek<F>(5))) {
             
             // "<?xml "
             p += 6;
@@ -730,28 +1273,27 @@ public:
         }
         while(true) {
             
-            Impl::Skipper<Impl::Space>::skip(p);
-            if(!*p) break;
+            skip<F, Impl::Space>();
+            if(!peek<F>()) break;
             else if(*p == '<') {
                 
                 ++p;
-                if(*p == '!') {
+                if(peek<F>() == '!') {
                     
                     ++p;
-                    if(p[0] == '-' && p[1] == '-') {
+                    if(match<F>("--")) {
                         
                         p += 2;
                         parseComment<F>(handler);
                         
-                    } else if(p[0] == 'D' && p[1] == 'O' && p[2] == 'C' && p[3] == 'T' && p[4] == 'Y' && p[5] == 'P' && p[6] == 'E') {
+                    } else if(match<F>("DOCTYPE")) {
                         
-                        // "DOCTYPE"
                         p += 7;
                         parseDoctype<F>(handler);
                         
                     } else throw XMLParseException("Unexpected character", p - s);
                     
-                } else if(*p == '?') {
+                } else if(peek<F>() == '?') {
                     
                     ++p;
                     parseProcessingInstruction<F>(handler);
@@ -770,6 +1312,67 @@ public:
         
     }
     
+public:
+    
+    XMLParser() : s(), p(), e(), allocator(), arena(&allocator), stack(), maxDepth(DefaultMaxDepth), skipping(), cursor(), indexEnd() {}
+    // Values decoded by a non-destructive parse are stored in the given
+    // allocator instead of one owned by the parser.
+    XMLParser(FastAllocator& arena_) : s(), p(), e(), allocator(), arena(&arena_), stack(), maxDepth(DefaultMaxDepth), skipping(), cursor(), indexEnd() {}
+    XMLParser(const XMLParser& src) = delete;
+    
+    // Documents with elements nested deeper than this fail to parse
+    std::size_t getMaxDepth() const { return maxDepth; }
+    void setMaxDepth(std::size_t maxDepth_) { maxDepth = maxDepth_; }
+    
+    // May be called by a handler in startElement() to skip the element. Its
+    // attributes and content are scanned without being decoded or reported,
+    // and endElement() is the only event left for it, even if it is empty.
+    void skipCurrentElement() { skipping = true; }
+    // The position in the data. In a handler, it is just past the markup of
+    // the event, e.g. past the > of the start tag in endAttributes().
+    const char* getPosition() const { return p; }
+    
+    template <Flag F = Flag::Default, typename H>
+    void parse(char* data, H& handler) {
+        
+        assert(data);
+        
+        if(F & Flag::NonDestructive) clearArena();
+        s = data;
+        p = data;
+        e = nullptr;
+        skipping = false;
+        parseDocument<F>(handler);
+        
+    }
+    template <Flag F = Flag::Default, typename H>
+    void parse(char* data, std::size_t length, H& handler) {
+        
+        assert(data || !length);
+        
+        if(F & Flag::NonDestructive) clearArena();
+        s = data;
+        p = data;
+        e = data + length;
+        skipping = false;
+        parseDocument<F | Bounded>(handler);
+        
+    }
+    // Read-only data is always parsed non-destructively. The data is never
+    // written to, so casting away const is safe.
+    template <Flag F = Flag::Default, typename H>
+    void parse(const char* data, H& handler) {
+        
+        parse<F | Flag::NonDestructive>(const_cast<char*>(data), handler);
+        
+    }
+    template <Flag F = Flag::Default, typename H>
+    void parse(const char* data, std::size_t length, H& handler) {
+        
+        parse<F | Flag::NonDestructive>(const_cast<char*>(data), length, handler);
+        
+    }
+    
 };
 
 }
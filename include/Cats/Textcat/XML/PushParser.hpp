@@ -0,0 +1,355 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CATS_TEXTCAT_XML_PUSHPARSER_HPP
+#define CATS_TEXTCAT_XML_PUSHPARSER_HPP
+
+
+#include <cassert>
+#include <cstring>
+
+#include <vector>
+
+#include "Cats/Corecat/Text/String.hpp"
+
+#include "Parser.hpp"
+
+
+namespace Cats {
+namespace Textcat{
+inline namespace XML {
+
+template <typename H, XMLParser::Flag F = XMLParser::Flag::Default>
+class XMLPushParser {
+    
+private:
+    
+    using StringView8 = Corecat::StringView8;
+    using Flag = XMLParser::Flag;
+    
+    enum class State {
+        
+        Start,
+        Declaration,
+        Misc,
+        Content,
+        End,
+        
+    };
+    
+    static constexpr Flag G = F | XMLParser::Bounded;
+    
+private:
+    
+    XMLParser parser;
+    H* handler;
+    State state;
+    // Data fed but not consumed yet, starting at pos
+    std::vector<char> buffer;
+    std::size_t pos;
+    // How far the token at pos has been scanned, and the quote character
+    // the scan is in (start tags only)
+    std::size_t scan;
+    char quote;
+    // Element types of the open elements
+    std::vector<char> names;
+    std::vector<std::size_t> nameStarts;
+    
+private:
+    
+    // Points the parser at the token [pos, end) of the buffer
+    void setup(std::size_t begin, std::size_t end) {
+        
+        parser.s = buffer.data();
+        parser.p = buffer.data() + begin;
+        parser.e = buffer.data() + end;
+        
+    }
+    std::size_t consumed() const { return parser.p - buffer.data(); }
+    
+    StringView8 getName() const {
+        
+        return StringView8(names.data() + nameStarts.back(), names.size() - nameStarts.back());
+        
+    }
+    void pushName(StringView8 name) {
+        
+        nameStarts.push_back(names.size());
+        names.insert(names.end(), name.getData(), name.getData() + name.getLength());
+        
+    }
+    void popName() {
+        
+        names.resize(nameStarts.back());
+        nameStarts.pop_back();
+        
+    }
+    
+    bool match(std::size_t i, const char* str, std::size_t length) const {
+        
+        return buffer.size() - i >= length && std::memcmp(buffer.data() + i, str, length) == 0;
+        
+    }
+    // Finds the terminator C... of the token at pos, scanning from start.
+    // Returns the end of the token, or 0 if more data is needed.
+    template <char... C>
+    std::size_t find(std::size_t start, bool last) {
+        
+        const std::size_t n = buffer.size();
+        auto t = buffer.data() + std::max(start, scan);
+        Impl::Searcher<C...>::search(t, buffer.data() + n);
+        if(t != buffer.data() + n && *t) return t - buffer.data() + sizeof...(C);
+        if(last || t != buffer.data() + n) throw XMLParseException("Unexpected end of data", t - buffer.data());
+        // The terminator may start in the last bytes
+        scan = std::max(start, n - std::min(n, sizeof...(C) - 1));
+        return 0;
+        
+    }
+    // Finds the ">" of a start tag, skipping those in attribute values
+    std::size_t findTagEnd(bool last) {
+        
+        const std::size_t n = buffer.size();
+        auto t = std::max(pos + 1, scan);
+        for(; t != n; ++t) {
+            
+            const char c = buffer[t];
+            if(quote) { if(c == quote) quote = 0; }
+            else if(c == '"' || c == '\'') quote = c;
+            else if(c == '>') { quote = 0; return t + 1; }
+            else if(!c) break;
+            
+        }
+        if(last || t != n) throw XMLParseException("Unexpected end of data", t);
+        scan = n;
+        return 0;
+        
+    }
+    
+    // Consumes complete tokens, returns when more data is needed
+    void process(bool last) {
+        
+        using namespace Corecat::Util;
+        
+        while(true) {
+            
+            const std::size_t n = buffer.size();
+            switch(state) {
+            
+            case State::Start: {
+                
+                handler->startDocument();
+                state = State::Declaration;
+                break;
+                
+            }
+            case State::Declaration: {
+                
+                // BOM and XML declaration, "\xEF\xBB\xBF<?xml "
+                if(n - pos < 9 && !last) return;
+                const std::size_t begin = match(pos, "\xEF\xBB\xBF", 3) ? pos + 3 : pos;
+                if(match(begin, "<?xml", 5) && n - begin > 5 &&
+                    SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(buffer[begin + 5])) {
+                    
+                    const std::size_t end = find<'?', '>'>(begin + 6, last);
+                    if(!end) return;
+                    setup(begin + 6, end);
+                    parser.parseXMLDeclaration<G>(*handler);
+                    pos = consumed();
+                    
+                } else pos = begin;
+                scan = pos;
+                state = State::Misc;
+                break;
+                
+            }
+            case State::Misc:
+            case State::Content: {
+                
+                if(pos == n) return;
+                if(buffer[pos] != '<') {
+                    
+                    if(state == State::Misc) {
+                        
+                        // Only white space is allowed outside the root element
+                        auto t = buffer.data() + pos;
+                        Impl::Skipper<Impl::Space>::skip(t, buffer.data() + n);
+                        pos = t - buffer.data();
+                        scan = pos;
+                        if(pos == n) return;
+                        if(buffer[pos] != '<') throw XMLParseException("Expected <", pos);
+                        continue;
+                        
+                    }
+                    
+                    // Text is complete once the next "<" is seen
+                    auto t = static_cast<const char*>(std::memchr(buffer.data() + scan, '<', n - scan));
+                    if(!t) {
+                        
+                        if(last) throw XMLParseException("Unexpected end of data", n);
+                        scan = n;
+                        return;
+                        
+                    }
+                    setup(pos, t - buffer.data() + 1);
+                    if(F & Flag::TrimSpace) parser.skip<G, Impl::Space>();
+                    if(parser.peek<G>() != '<') parser.parseText<G>(*handler);
+                    pos = consumed();
+                    scan = pos;
+                    break;
+                    
+                }
+                
+                if(n - pos < 2) { if(last) throw XMLParseException("Unexpected end of data", n); return; }
+                switch(buffer[pos + 1]) {
+                
+                case '?': {
+                    
+                    const std::size_t end = find<'?', '>'>(pos + 2, last);
+                    if(!end) return;
+                    setup(pos + 2, end);
+                    parser.parseProcessingInstruction<G>(*handler);
+                    break;
+                    
+                }
+                case '!': {
+                    
+                    if(n - pos < 9 && !last) return;
+                    if(match(pos, "<!--", 4)) {
+                        
+                        const std::size_t end = find<'-', '-', '>'>(pos + 4, last);
+                        if(!end) return;
+                        setup(pos + 4, end);
+                        parser.parseComment<G>(*handler);
+                        
+                    } else if(state == State::Content && match(pos, "<![CDATA[", 9)) {
+                        
+                        const std::size_t end = find<']', ']', '>'>(pos + 9, last);
+                        if(!end) return;
+                        setup(pos + 9, end);
+                        parser.parseCDATA<G>(*handler);
+                        
+                    } else if(state == State::Misc && match(pos, "<!DOCTYPE", 9)) {
+                        
+                        setup(pos + 9, n);
+                        parser.parseDoctype<G>(*handler);
+                        
+                    } else throw XMLParseException("Unexpected character", pos + 2);
+                    break;
+                    
+                }
+                case '/': {
+                    
+                    if(state != State::Content) throw XMLParseException("Unexpected character", pos + 1);
+                    auto t = static_cast<const char*>(std::memchr(buffer.data() + std::max(pos + 2, scan), '>', n - std::max(pos + 2, scan)));
+                    if(!t) {
+                        
+                        if(last) throw XMLParseException("Unexpected end of data", n);
+                        scan = n;
+                        return;
+                        
+                    }
+                    setup(pos + 2, t - buffer.data() + 1);
+                    parser.parseEndTag<G>(*handler, getName());
+                    popName();
+                    if(nameStarts.empty()) state = State::Misc;
+                    break;
+                    
+                }
+                default: {
+                    
+                    const std::size_t end = findTagEnd(last);
+                    if(!end) return;
+                    setup(pos + 1, end);
+                    parser.checkDepth(nameStarts.size());
+                    StringView8 name;
+                    if(!parser.parseStartTag<G>(*handler, name)) {
+                        
+                        pushName(name);
+                        state = State::Content;
+                        
+                    }
+                    break;
+                    
+                }
+                    
+                }
+                pos = consumed();
+                scan = pos;
+                break;
+                
+            }
+            case State::End: {
+                
+                throw XMLParseException("Data after finish", pos);
+                
+            }
+                
+            }
+            
+        }
+        
+    }
+    
+public:
+    
+    XMLPushParser(H& handler_) :
+        parser(), handler(&handler_), state(State::Start), buffer(), pos(), scan(), quote(), names(), nameStarts() {}
+    XMLPushParser(const XMLPushParser& src) = delete;
+    
+    std::size_t getMaxDepth() const { return parser.getMaxDepth(); }
+    void setMaxDepth(std::size_t maxDepth) { parser.setMaxDepth(maxDepth); }
+    
+    // Parses the next chunk of data. Events are emitted as soon as their
+    // token is complete; values are only valid during the callback.
+    void feed(const char* data, std::size_t length) {
+        
+        buffer.insert(buffer.end(), data, data + length);
+        process(false);
+        // Keep only the partial token
+        buffer.erase(buffer.begin(), buffer.begin() + pos);
+        scan -= pos;
+        pos = 0;
+        if(F & Flag::NonDestructive) parser.clearArena();
+        
+    }
+    // Signals the end of data
+    void finish() {
+        
+        process(true);
+        if(state == State::Content) throw XMLParseException("Unexpected end of data", buffer.size());
+        state = State::End;
+        handler->endDocument();
+        
+    }
+    
+};
+
+}
+}
+}
+
+
+#endif
@@ -0,0 +1,374 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CATS_TEXTCAT_XML_READER_HPP
+#define CATS_TEXTCAT_XML_READER_HPP
+
+
+#include <cassert>
+#include <cstdint>
+
+#include <vector>
+
+#include "Cats/Corecat/Text/String.hpp"
+#include "Cats/Corecat/Util/Sequence.hpp"
+
+#include "Handler.hpp"
+#include "Parser.hpp"
+
+
+namespace Cats {
+namespace Textcat{
+inline namespace XML {
+
+enum class XMLTokenType {
+    
+    None,
+    StartElement,
+    EndElement,
+    Text,
+    CDATA,
+    Comment,
+    ProcessingInstruction,
+    EndDocument,
+    
+};
+
+template <XMLParser::Flag F = XMLParser::Flag::Default>
+class XMLReader {
+    
+private:
+    
+    using StringView8 = Corecat::StringView8;
+    using Flag = XMLParser::Flag;
+    
+    enum class State {
+        
+        Start,
+        Misc,
+        Content,
+        End,
+        
+    };
+    
+    struct Attribute {
+        
+        StringView8 name;
+        StringView8 value;
+        
+    };
+    
+    // Stores the events of one token in the reader
+    class Recorder : public XMLHandlerBase {
+        
+    private:
+        
+        XMLReader* reader;
+        
+    public:
+        
+        Recorder(XMLReader& reader_) : reader(&reader_) {}
+        
+        void startElement(StringView8 name) { reader->type = XMLTokenType::StartElement; reader->name = name; }
+        void endElement(StringView8 name) { reader->type = XMLTokenType::EndElement; reader->name = name; }
+        void endAttributes(bool empty) { reader->empty = empty; }
+        void attribute(StringView8 name, StringView8 value) { reader->attributes.push_back({name, value}); }
+        void text(StringView8 value) { reader->type = XMLTokenType::Text; reader->value = value; }
+        void cdata(StringView8 value) { reader->type = XMLTokenType::CDATA; reader->value = value; }
+        void comment(StringView8 value) { reader->type = XMLTokenType::Comment; reader->value = value; }
+        void processingInstruction(StringView8 name, StringView8 value) {
+            
+            reader->type = XMLTokenType::ProcessingInstruction;
+            reader->name = name;
+            reader->value = value;
+            
+        }
+        
+    };
+    
+private:
+    
+    XMLParser parser;
+    bool bounded;
+    bool readOnly;
+    State state;
+    XMLTokenType type;
+    StringView8 name;
+    StringView8 value;
+    std::vector<Attribute> attributes;
+    // The current start tag is empty, so its end element comes next
+    bool empty;
+    
+private:
+    
+    template <Flag G>
+    XMLTokenType parseStartTag(Recorder& recorder) {
+        
+        parser.checkDepth(parser.stack.size());
+        if(!parser.parseStartTag<G>(recorder, name)) {
+            
+            parser.stack.push_back(name);
+            state = State::Content;
+            
+        }
+        return type;
+        
+    }
+    template <Flag G>
+    XMLTokenType parseNext() {
+        
+        using namespace Corecat::Util;
+        
+        char*& p = parser.p;
+        attributes.clear();
+        if(empty) {
+            
+            empty = false;
+            type = XMLTokenType::EndElement;
+            return type;
+            
+        }
+        
+        Recorder recorder(*this);
+        while(true) {
+            
+            switch(state) {
+            
+            case State::Start: {
+                
+                // Parse BOM
+                if(parser.match<G>("\xEF\xBB\xBF")) p += 3;
+                
+                // Parse XML declaration
+                if(parser.match<G>("<?xml") && SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(parser.peek<G>(5))) {
+                    
+                    // "<?xml "
+                    p += 6;
+                    parser.parseXMLDeclaration<G>(recorder);
+                    
+                }
+                state = State::Misc;
+                break;
+                
+            }
+            case State::Misc: {
+                
+                parser.skip<G, Impl::Space>();
+                if(!parser.peek<G>()) {
+                    
+                    state = State::End;
+                    break;
+                    
+                }
+                if(*p != '<') throw XMLParseException("Expected <", p - parser.s);
+                ++p;
+                if(parser.peek<G>() == '!') {
+                    
+                    ++p;
+                    if(parser.match<G>("--")) {
+                        
+                        p += 2;
+                        parser.parseComment<G>(recorder);
+                        return type;
+                        
+                    } else if(parser.match<G>("DOCTYPE")) {
+                        
+                        p += 7;
+                        parser.parseDoctype<G>(recorder);
+                        break;
+                        
+                    } else throw XMLParseException("Unexpected character", p - parser.s);
+                    
+                } else if(parser.peek<G>() == '?') {
+                    
+                    ++p;
+                    parser.parseProcessingInstruction<G>(recorder);
+                    return type;
+                    
+                } else return parseStartTag<G>(recorder);
+                
+            }
+            case State::Content: {
+                
+                // Parse text
+                if(F & Flag::TrimSpace) parser.skip<G, Impl::Space>();
+                if(parser.peek<G>() != '<') {
+                    
+                    parser.parseText<G>(recorder);
+                    return type;
+                    
+                }
+                
+                ++p;
+                switch(parser.peek<G>()) {
+                
+                case '!': {
+                    
+                    ++p;
+                    if(parser.match<G>("--")) {
+                        
+                        p += 2;
+                        parser.parseComment<G>(recorder);
+                        
+                    } else if(parser.match<G>("[CDATA[")) {
+                        
+                        p += 7;
+                        parser.parseCDATA<G>(recorder);
+                        
+                    } else throw XMLParseException("Unexpected character", p - parser.s);
+                    return type;
+                    
+                }
+                case '/': {
+                    
+                    ++p;
+                    parser.parseEndTag<G>(recorder, parser.stack.back());
+                    parser.stack.pop_back();
+                    if(parser.stack.empty()) state = State::Misc;
+                    return type;
+                    
+                }
+                case '?': {
+                    
+                    ++p;
+                    parser.parseProcessingInstruction<G>(recorder);
+                    return type;
+                    
+                }
+                default: return parseStartTag<G>(recorder);
+                    
+                }
+                
+            }
+            case State::End: {
+                
+                type = XMLTokenType::EndDocument;
+                return type;
+                
+            }
+                
+            }
+            
+        }
+        
+    }
+    
+    XMLReader() : parser(), bounded(), readOnly(), state(State::Start), type(XMLTokenType::None), name(), value(), attributes(), empty() {}
+    
+    template <Flag G>
+    void skipContent() {
+        
+        if(empty) empty = false;
+        else {
+            
+            parser.skipContent<G>();
+            name = parser.stack.back();
+            parser.stack.pop_back();
+            if(parser.stack.empty()) state = State::Misc;
+            
+        }
+        attributes.clear();
+        type = XMLTokenType::EndElement;
+        
+    }
+    
+    void open(char* data, std::size_t length, bool bounded_, bool readOnly_) {
+        
+        parser.s = data;
+        parser.p = data;
+        parser.e = bounded_ ? data + length : nullptr;
+        parser.stack.clear();
+        bounded = bounded_;
+        readOnly = readOnly_;
+        
+    }
+    
+public:
+    
+    // Like XMLParser::parse, the data is modified in place unless it is
+    // read-only or F contains Flag::NonDestructive. Names and values are
+    // valid until the next call to next() or skip(), which free the values
+    // that a non-destructive parse decoded, so that memory does not grow
+    // with the document.
+    XMLReader(char* data) : XMLReader() { assert(data); open(data, 0, false, false); }
+    XMLReader(char* data, std::size_t length) : XMLReader() { assert(data || !length); open(data, length, true, false); }
+    XMLReader(const char* data) : XMLReader() { assert(data); open(const_cast<char*>(data), 0, false, true); }
+    XMLReader(const char* data, std::size_t length) : XMLReader() {
+        
+        assert(data || !length);
+        open(const_cast<char*>(data), length, true, true);
+        
+    }
+    XMLReader(const XMLReader& src) = delete;
+    
+    // Moves to the next token and returns its type
+    XMLTokenType next() {
+        
+        if(readOnly || (F & Flag::NonDestructive)) parser.clearArena();
+        constexpr Flag B = XMLParser::Bounded;
+        constexpr Flag N = Flag::NonDestructive;
+        if(bounded) return readOnly ? parseNext<F | B | N>() : parseNext<F | B>();
+        else return readOnly ? parseNext<F | N>() : parseNext<F>();
+        
+    }
+    // Skips the content of the current StartElement without decoding it,
+    // after which the current token is its EndElement
+    void skip() {
+        
+        assert(type == XMLTokenType::StartElement);
+        
+        if(readOnly || (F & Flag::NonDestructive)) parser.clearArena();
+        constexpr Flag B = XMLParser::Bounded;
+        constexpr Flag N = Flag::NonDestructive;
+        if(bounded) readOnly ? skipContent<F | B | N>() : skipContent<F | B>();
+        else readOnly ? skipContent<F | N>() : skipContent<F>();
+        
+    }
+    
+    XMLTokenType getType() const { return type; }
+    // Element type, or target of a processing instruction
+    StringView8 getName() const { return name; }
+    // Content of a text, CDATA, comment or processing instruction
+    StringView8 getValue() const { return value; }
+    // Number of open elements, including the current StartElement
+    std::size_t getDepth() const { return parser.stack.size() + empty; }
+    
+    // Attributes of the current StartElement
+    std::size_t getAttributeCount() const { return attributes.size(); }
+    StringView8 getAttributeName(std::size_t i) const { assert(i < attributes.size()); return attributes[i].name; }
+    StringView8 getAttributeValue(std::size_t i) const { assert(i < attributes.size()); return attributes[i].value; }
+    
+    std::size_t getMaxDepth() const { return parser.getMaxDepth(); }
+    void setMaxDepth(std::size_t maxDepth) { parser.setMaxDepth(maxDepth); }
+    
+};
+
+}
+}
+}
+
+
+#endif
@@ -0,0 +1,305 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CATS_TEXTCAT_XML_RECORDPARSER_HPP
+#define CATS_TEXTCAT_XML_RECORDPARSER_HPP
+
+
+#include <cassert>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Cats/Corecat/Text/String.hpp"
+#include "Cats/Corecat/Util/Sequence.hpp"
+
+#include "Document.hpp"
+#include "Handler.hpp"
+#include "Parser.hpp"
+
+
+namespace Cats {
+namespace Textcat{
+inline namespace XML {
+
+// Parses the elements at one depth of a document (by default the children
+// of the root element, e.g. the records of a data file) on several
+// threads. A pre-scan that only follows markup finds the records, then
+// each record is parsed on its own as a document.
+class XMLRecordParser {
+    
+private:
+    
+    using StringView8 = Corecat::StringView8;
+    using Flag = XMLParser::Flag;
+    
+private:
+    
+    std::size_t threadCount;
+    std::size_t depth;
+    bool ordered;
+    
+private:
+    
+    // Runs f(i, thread) for each record i on count threads, stopping at the
+    // first exception. Then stopped is set and stop() is called, so that
+    // threads waiting inside f() can give up.
+    template <typename T, typename S>
+    void run(std::size_t recordCount, std::size_t count, std::atomic<bool>& stopped, T f, S stop) const {
+        
+        std::atomic<std::size_t> next(0);
+        std::exception_ptr error;
+        std::mutex mutex;
+        auto work = [&](std::size_t thread) {
+            
+            try {
+                
+                for(std::size_t i; !stopped && (i = next++) < recordCount; ) f(i, thread);
+                
+            } catch(...) {
+                
+                {
+                    
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(!error) error = std::current_exception();
+                    stopped = true;
+                    
+                }
+                stop();
+                
+            }
+            
+        };
+        std::vector<std::thread> threads;
+        for(std::size_t i = 1; i < count; ++i) threads.emplace_back(work, i);
+        work(0);
+        for(auto& thread : threads) thread.join();
+        if(error) std::rethrow_exception(error);
+        
+    }
+    
+public:
+    
+    // threadCount is the number of threads, 0 for one per hardware thread.
+    // The root element has depth 0.
+    XMLRecordParser(std::size_t threadCount_ = 0, std::size_t depth_ = 1) :
+        threadCount(threadCount_ ? threadCount_ : std::max(std::thread::hardware_concurrency(), 1u)),
+        depth(depth_), ordered() {}
+    XMLRecordParser(const XMLRecordParser& src) = delete;
+    
+    std::size_t getThreadCount() const { return threadCount; }
+    std::size_t getDepth() const { return depth; }
+    void setDepth(std::size_t depth_) { depth = depth_; }
+    // Whether documents are delivered in document order. Records are still
+    // parsed concurrently, but each callback waits for the one before.
+    bool isOrdered() const { return ordered; }
+    void setOrdered(bool ordered_) { ordered = ordered_; }
+    
+    // Returns the source of each element at depth. Only markup boundaries
+    // and the nesting depth are followed, the records are checked when they
+    // are parsed.
+    template <Flag F = Flag::Default>
+    std::vector<StringView8> scan(const char* data, std::size_t length) const {
+        
+        using namespace Corecat::Util;
+        
+        assert(data || !length);
+        
+        constexpr Flag G = F | XMLParser::Bounded | Flag::NonDestructive;
+        
+        // Skipping does not modify the data
+        XMLParser parser;
+        parser.s = const_cast<char*>(data);
+        parser.p = const_cast<char*>(data);
+        parser.e = const_cast<char*>(data + length);
+        char*& p = parser.p;
+        XMLHandlerBase handler;
+        if(parser.match<G>("\xEF\xBB\xBF")) p += 3;
+        if(parser.match<G>("<?xml") && SequenceTable<MapperSequence<Impl::Space, IndexSequence<int, 0, 256>>>::get(parser.peek<G>(5))) {
+            
+            // "<?xml "
+            p += 6;
+            parser.parseXMLDeclaration<G>(handler);
+            
+        }
+        
+        std::vector<StringView8> records;
+        std::size_t cur = 0;
+        while(true) {
+            
+            parser.skip<G, Impl::Text>();
+            if(!parser.peek<G>()) break;
+            
+            auto begin = p++;
+            switch(parser.peek<G>()) {
+            
+            case '!': {
+                
+                ++p;
+                if(parser.match<G>("--")) {
+                    
+                    p += 2;
+                    parser.search<G, '-', '-', '>'>();
+                    if(!parser.peek<G>()) throw XMLParseException("Unexpected end of data", p - data);
+                    p += 3;
+                    
+                } else if(parser.match<G>("[CDATA[")) {
+                    
+                    p += 7;
+                    parser.search<G, ']', ']', '>'>();
+                    if(!parser.peek<G>()) throw XMLParseException("Unexpected end of data", p - data);
+                    p += 3;
+                    
+                } else if(parser.match<G>("DOCTYPE")) {
+                    
+                    p += 7;
+                    parser.parseDoctype<G>(handler);
+                    
+                } else throw XMLParseException("Unexpected character", p - data);
+                break;
+                
+            }
+            case '/': {
+                
+                if(!cur) throw XMLParseException("Expected element type", p - data);
+                ++p;
+                parser.skipTag<G>();
+                --cur;
+                break;
+                
+            }
+            case '?': {
+                
+                ++p;
+                parser.search<G, '?', '>'>();
+                if(!parser.peek<G>()) throw XMLParseException("Unexpected end of data", p - data);
+                p += 2;
+                break;
+                
+            }
+            default: {
+                
+                if(cur == depth) {
+                    
+                    if(!parser.skipTag<G>()) parser.skipContent<G>();
+                    records.emplace_back(begin, p - begin);
+                    
+                } else if(!parser.skipTag<G>()) ++cur;
+                break;
+                
+            }
+                
+            }
+            
+        }
+        if(cur) throw XMLParseException("Unexpected end of data", p - data);
+        return records;
+        
+    }
+    
+    // Parses each record into an XMLDocument of the thread and calls
+    // callback(i, document) for record i, where the root element of the
+    // document is the record. Values are views into the data like with
+    // Flag::NonDestructive, and the document is reused after the callback.
+    template <Flag F = Flag::Default, typename C>
+    void parse(const char* data, std::size_t length, C callback) const {
+        
+        const auto records = scan<F>(data, length);
+        const std::size_t count = std::min(threadCount, std::max<std::size_t>(records.size(), 1));
+        std::vector<XMLDocument> documents(count);
+        std::size_t turn = 0;
+        std::atomic<bool> stopped(false);
+        std::mutex mutex;
+        std::condition_variable condition;
+        run(records.size(), count, stopped, [&](std::size_t i, std::size_t thread) {
+            
+            auto& document = documents[thread];
+            document.parse<F>(records[i].getData(), records[i].getLength());
+            if(ordered) {
+                
+                // A failed record never takes its turn, so the later ones
+                // give up when the parse stops
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&]() { return turn == i || stopped; });
+                if(turn != i) return;
+                
+            }
+            callback(i, document);
+            if(ordered) {
+                
+                {
+                    
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++turn;
+                    
+                }
+                condition.notify_all();
+                
+            }
+            
+        }, [&]() {
+            
+            // Under the mutex, so that no thread misses it between checking
+            // stopped and waiting
+            std::lock_guard<std::mutex> lock(mutex);
+            condition.notify_all();
+            
+        });
+        
+    }
+    // Parses the records with one thread per handler. Each record is parsed
+    // as a document by the handler of the thread that takes it, in no
+    // particular order.
+    template <Flag F = Flag::Default, typename H>
+    void parse(const char* data, std::size_t length, std::vector<H>& handlers) const {
+        
+        assert(!handlers.empty());
+        
+        const auto records = scan<F>(data, length);
+        std::vector<XMLParser> parsers(handlers.size());
+        std::atomic<bool> stopped(false);
+        run(records.size(), handlers.size(), stopped, [&](std::size_t i, std::size_t thread) {
+            
+            parsers[thread].parse<F>(records[i].getData(), records[i].getLength(), handlers[thread]);
+            
+        }, []() {});
+        
+    }
+    
+};
+
+}
+}
+}
+
+
+#endif
@@ -29,21 +29,196 @@
 
 
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <utility>
 
 #include "Cats/Corecat/Data/Stream/OutputStream.hpp"
 #include "Cats/Corecat/Text/String.hpp"
 
 #include "Handler.hpp"
+#include "Parser.hpp"
+#include "Sink.hpp"
 
 
 namespace Cats {
 namespace Textcat{
 inline namespace XML {
 
-class XMLSerializer : public XMLHandlerBase {
+namespace Impl {
+
+// Characters that are written as references in text and in attribute values
+using EscapeText = Exclude<unsigned char, '&', '<', '>'>;
+using EscapeAttribute = Exclude<unsigned char, '"', '&', '<', '>'>;
+
+// Returns the offset of the first character in [p, p + length) that does
+// not satisfy Cond, or length. Values are often only a few bytes long, so
+// the last block is also compared with SIMD if reading it whole cannot
+// cross into another page.
+template <typename Cond>
+std::size_t findEscape(const char* p, std::size_t length) {
+    
+    using namespace Corecat;
+    
+    std::size_t i = 0;
+#if defined(CATS_TEXTCAT_XML_SSE2)
+    using Matcher = typename SIMDMatcherSelector<Cond>::Type;
+    constexpr std::uintptr_t pageSize = 4096;
+    for(; length - i >= Matcher::blockSize; i += Matcher::blockSize) {
+        
+        const std::size_t index = Matcher::find(p + i, false);
+        if(index != Matcher::blockSize) return i + index;
+        
+    }
+    if(i != length && (reinterpret_cast<std::uintptr_t>(p + i) & (pageSize - 1)) <= pageSize - Matcher::blockSize)
+        return std::min(i + Matcher::find(p + i, false), length);
+#endif
+    for(; i != length; ++i) if(!SequenceTable<MapperSequence<Cond, IndexSequence<int, 0, 256>>>::get(p[i])) break;
+    return i;
+
+}
+
+}
+
+// Formatting policies of BasicXMLSerializer. Each hook is called before the
+// markup it is named after and may write white space with out(data, length).
+class XMLCompactFormat {
+    
+public:
+    
+    template <typename O>
+    void startElement(O& /*out*/) {}
+    template <typename O>
+    void attribute(O& out) { out(" ", 1); }
+    template <typename O>
+    void endAttributes(O& /*out*/, bool /*empty*/) {}
+    template <typename O>
+    void endElement(O& /*out*/) {}
+    template <typename O>
+    void text(O& /*out*/) {}
+    // Before a comment or a processing instruction
+    template <typename O>
+    void node(O& /*out*/) {}
+    template <typename O>
+    void endDocument(O& /*out*/) {}
+    
+};
+
+// Puts each element, comment and processing instruction on its own line,
+// indented by its depth. Once an element contains text, its content is
+// written as it is, since white space added there would change the text.
+class XMLIndentFormat {
+    
+private:
+    
+    using StringView8 = Corecat::StringView8;
+    
+protected:
+    
+    // A line break followed by indentation, extended as deeper levels appear
+    std::string line;
+    std::size_t indentLength;
+    std::size_t depth;
+    // Depth of the outermost open element with text, 0 if there is none
+    std::size_t mixedDepth;
+    // Whether the innermost open element has no content so far
+    bool empty;
+    bool started;
+    
+protected:
+    
+    template <typename O>
+    void newLine(O& out, std::size_t level) {
+        
+        const std::size_t length = 1 + level * indentLength;
+        while(line.size() < length) line.append(line, 1, indentLength);
+        out(line.data(), length);
+        
+    }
+    
+public:
+    
+    XMLIndentFormat(StringView8 indent = "    ") :
+        line("\n" + std::string(indent.getData(), indent.getLength())), indentLength(indent.getLength()),
+        depth(), mixedDepth(), empty(), started() {}
+    
+    template <typename O>
+    void startElement(O& out) {
+        
+        node(out);
+        ++depth;
+        empty = true;
+        
+    }
+    template <typename O>
+    void attribute(O& out) { out(" ", 1); }
+    template <typename O>
+    void endAttributes(O& /*out*/, bool empty_) {
+        
+        if(empty_) { --depth; empty = false; }
+        
+    }
+    template <typename O>
+    void endElement(O& out) {
+        
+        if(!empty && !mixedDepth) newLine(out, depth - 1);
+        if(mixedDepth == depth) mixedDepth = 0;
+        --depth;
+        empty = false;
+        
+    }
+    template <typename O>
+    void text(O& /*out*/) {
+        
+        if(depth && !mixedDepth) mixedDepth = depth;
+        empty = false;
+        
+    }
+    template <typename O>
+    void node(O& out) {
+        
+        if(started && !mixedDepth) newLine(out, depth);
+        started = true;
+        empty = false;
+        
+    }
+    template <typename O>
+    void endDocument(O& out) {
+        
+        if(started) out("\n", 1);
+        depth = mixedDepth = 0;
+        empty = started = false;
+        
+    }
+    
+};
+
+// Like XMLIndentFormat, and also puts each attribute on its own line, one
+// level deeper than its element
+class XMLAttributePerLineFormat : public XMLIndentFormat {
+    
+public:
+    
+    using XMLIndentFormat::XMLIndentFormat;
+    
+    template <typename O>
+    void attribute(O& out) {
+        
+        if(mixedDepth) out(" ", 1);
+        else newLine(out, depth);
+        
+    }
+    
+};
+
+// Writes the events it receives as XML to a sink, see Sink.hpp, formatted
+// by Format
+template <typename Sink, typename Format = XMLCompactFormat>
+class BasicXMLSerializer : public XMLHandlerBase {
     
 private:
     
@@ -53,77 +228,155 @@ private:
     
 private:
     
-    OutputStream<char>* stream;
+    Sink sink;
+    bool escaping;
+    Format format;
+    
+private:
+    
+    void write(const char* data, std::size_t length) { sink.write(data, length); }
+    // For data that stays where it is, see Sink.hpp
+    void reference(const char* data, std::size_t length) { Impl::reference(sink, data, length, 0); }
+    template <std::size_t N>
+    void write(const char (&str)[N]) { write(str, N - 1); }
+    // Passed to the hooks of the format
+    auto writer() { return [this](const char* data, std::size_t length) { write(data, length); }; }
+    void write(StringView8 str) { reference(str.getData(), str.getLength()); }
+    // Copies the runs between characters that need a reference as they are
+    template <typename Cond>
+    void writeEscaped(StringView8 str) {
+        
+        auto p = str.getData();
+        const auto e = p + str.getLength();
+        while(true) {
+            
+            const std::size_t length = Impl::findEscape<Cond>(p, e - p);
+            reference(p, length);
+            p += length;
+            if(p == e) break;
+            switch(*p++) {
+            
+            case '"': write("&quot;"); break;
+            case '&': write("&amp;"); break;
+            case '<': write("&lt;"); break;
+            default: write("&gt;"); break;
+                
+            }
+            
+        }
+        
+    }
     
 public:
     
-    XMLSerializer(OutputStream<char>& stream_) : stream(&stream_) {}
+    BasicXMLSerializer(Sink sink_, Format format_ = Format()) : sink(std::move(sink_)), escaping(true), format(format_) {}
+    BasicXMLSerializer(const BasicXMLSerializer& src) = delete;
     
     void startDocument() {}
-    void endDocument() {}
+    void endDocument() {
+        
+        auto out = writer();
+        format.endDocument(out);
+        flush();
+        
+    }
     void startElement(StringView8 name) {
         
-        stream->writeAll("<", 1);
-        stream->writeAll(name.getData(), name.getLength());
+        auto out = writer();
+        format.startElement(out);
+        write("<");
+        write(name);
         
     }
     void endElement(StringView8 name) {
         
-        stream->writeAll("</", 2);
-        stream->writeAll(name.getData(), name.getLength());
-        stream->writeAll(">", 1);
+        auto out = writer();
+        format.endElement(out);
+        write("</");
+        write(name);
+        write(">");
         
     }
     void endAttributes(bool empty) {
         
-        if(empty) stream->writeAll("/>", 2);
-        else stream->writeAll(">", 1);
+        auto out = writer();
+        format.endAttributes(out, empty);
+        if(empty) write("/>");
+        else write(">");
         
     }
     void doctype() {}
-    void attribute(StringView8 name, StringView8 value) {
+    void attribute(StringView8 name, StringView8 value) { attribute(name, value, escaping); }
+    // With escape set to false the value is written as it is, e.g. when it
+    // comes from a parse without Flag::EntityTranslation and is still escaped
+    void attribute(StringView8 name, StringView8 value, bool escape) {
         
-        stream->writeAll(" ", 1);
-        stream->writeAll(name.getData(), name.getLength());
-        stream->writeAll("=\"", 2);
-        stream->writeAll(value.getData(), value.getLength());
-        stream->writeAll("\"", 1);
+        auto out = writer();
+        format.attribute(out);
+        write(name);
+        write("=\"");
+        if(escape) writeEscaped<Impl::EscapeAttribute>(value);
+        else write(value);
+        write("\"");
         
     }
-    void text(StringView8 value) {
+    void text(StringView8 value) { text(value, escaping); }
+    void text(StringView8 value, bool escape) {
         
-        stream->writeAll(value.getData(), value.getLength());
+        auto out = writer();
+        format.text(out);
+        if(escape) writeEscaped<Impl::EscapeText>(value);
+        else write(value);
         
     }
     void cdata(StringView8 value) {
         
-        stream->writeAll("<![CDATA[", 9);
-        stream->writeAll(value.getData(), value.getLength());
-        stream->writeAll("]]>", 3);
+        auto out = writer();
+        format.text(out);
+        write("<![CDATA[");
+        write(value);
+        write("]]>");
         
     }
     void comment(StringView8 value) {
         
-        stream->writeAll("<!--", 4);
-        stream->writeAll(value.getData(), value.getLength());
-        stream->writeAll("-->", 3);
+        auto out = writer();
+        format.node(out);
+        write("<!--");
+        write(value);
+        write("-->");
         
     }
     void processingInstruction(StringView8 name, StringView8 value) {
         
-        stream->writeAll("<?", 2);
-        stream->writeAll(name.getData(), name.getLength());
-        stream->writeAll(" ", 1);
-        stream->writeAll(value.getData(), value.getLength());
-        stream->writeAll("?>", 2);
+        auto out = writer();
+        format.node(out);
+        write("<?");
+        write(name);
+        write(" ");
+        write(value);
+        write("?>");
         
     }
     
-    OutputStream<char>& getStream() { return *stream; }
-    void setStream(OutputStream<char>& stream_) { stream = &stream_; }
+    // Writes the output buffered by the sink. This happens by itself at
+    // endDocument(), so only output written without one needs it.
+    void flush() { sink.flush(); }
+    
+    Sink& getSink() { return sink; }
+    // Only for XMLStreamSink
+    OutputStream<char>& getStream() { return sink.getStream(); }
+    void setStream(OutputStream<char>& stream) { sink.setStream(stream); }
+    // Whether text and attribute values are escaped when no flag is given
+    // with the call, true by default
+    bool isEscaping() const { return escaping; }
+    void setEscaping(bool escaping_) { escaping = escaping_; }
+    Format& getFormat() { return format; }
     
 };
 
+using XMLSerializer = BasicXMLSerializer<XMLStreamSink>;
+
 }
 }
 }
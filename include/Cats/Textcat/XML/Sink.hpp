@@ -0,0 +1,508 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CATS_TEXTCAT_XML_SINK_HPP
+#define CATS_TEXTCAT_XML_SINK_HPP
+
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#   include <io.h>
+#else
+#   include <sys/uio.h>
+#   include <unistd.h>
+#endif
+
+#include "Cats/Corecat/Data/Stream/OutputStream.hpp"
+
+// For the paths of the sinks that are rarely taken. The serializer is
+// inlined into one large function, where they would crowd out the rest.
+#if defined(_MSC_VER)
+#   define CATS_TEXTCAT_XML_NOINLINE __declspec(noinline)
+#else
+#   define CATS_TEXTCAT_XML_NOINLINE __attribute__((noinline))
+#endif
+
+
+namespace Cats {
+namespace Textcat{
+inline namespace XML {
+
+// Sinks receive the output of BasicXMLSerializer through
+// write(data, length) and flush(). Writes are not virtual, so sinks that
+// write to memory inline into a plain copy. A sink may also have
+// reference(data, length), which receives the names and values given to
+// the serializer, so that it can keep pointers to them instead of copies.
+// Sinks without it receive them through write().
+
+namespace Impl {
+
+// Calls sink.reference() if the sink has one, sink.write() otherwise
+template <typename Sink>
+auto reference(Sink& sink, const char* data, std::size_t length, int) -> decltype(sink.reference(data, length)) {
+    
+    return sink.reference(data, length);
+
+}
+template <typename Sink>
+void reference(Sink& sink, const char* data, std::size_t length, long) { sink.write(data, length); }
+
+// Writes the whole data to a file descriptor. Failed writes throw
+// std::system_error with message.
+inline void writeFile(int fd, const char* data, std::size_t length, const char* message) {
+    
+    while(length) {
+
+#if defined(_WIN32)
+        const int result = ::_write(fd, data, static_cast<unsigned>(std::min<std::size_t>(length, 0x40000000)));
+#else
+        const auto result = ::write(fd, data, length);
+#endif
+        if(result < 0) {
+            
+            if(errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), message);
+            
+        }
+        data += result;
+        length -= result;
+        
+    }
+
+}
+
+}
+
+// Collects the output in a buffer and writes it to an OutputStream<char> in
+// large blocks
+class XMLStreamSink {
+    
+private:
+    
+    template <typename T>
+    using OutputStream = Corecat::OutputStream<T>;
+    
+public:
+    
+    static constexpr std::size_t DefaultBufferSize = 16384;
+    
+private:
+    
+    OutputStream<char>* stream;
+    std::unique_ptr<char[]> buffer;
+    std::size_t capacity;
+    std::size_t size;
+    
+public:
+    
+    XMLStreamSink(OutputStream<char>& stream_, std::size_t capacity_ = DefaultBufferSize) :
+        stream(&stream_), buffer(new char[capacity_ ? capacity_ : 1]), capacity(capacity_ ? capacity_ : 1), size() {}
+    XMLStreamSink(XMLStreamSink&& src) :
+        stream(src.stream), buffer(std::move(src.buffer)), capacity(src.capacity), size(src.size) { src.size = 0; }
+    // Writes what is left, e.g. when the serializer was used without
+    // endDocument(). Errors are lost here; call flush() to see them.
+    ~XMLStreamSink() {
+        
+        try { flush(); } catch(...) {}
+        
+    }
+    
+    void write(const char* data, std::size_t length) {
+        
+        if(capacity - size < length) {
+            
+            flush();
+            if(length >= capacity) { stream->writeAll(data, length); return; }
+            
+        }
+        std::memcpy(buffer.get() + size, data, length);
+        size += length;
+        
+    }
+    void flush() {
+        
+        if(size) stream->writeAll(buffer.get(), size);
+        size = 0;
+        
+    }
+    
+    OutputStream<char>& getStream() { return *stream; }
+    void setStream(OutputStream<char>& stream_) { flush(); stream = &stream_; }
+    std::size_t getBufferSize() const { return capacity; }
+    
+};
+
+// Appends to a container of char, such as std::string or std::vector<char>.
+// The container is grown ahead and written through a pointer, so it holds
+// unused space at its end until flush(), which BasicXMLSerializer calls at
+// endDocument().
+template <typename T>
+class XMLContainerSink {
+    
+private:
+    
+    T* container;
+    std::size_t length;
+    
+private:
+    
+    void grow(std::size_t count) {
+        
+        container->resize(std::max<std::size_t>({container->capacity(), container->size() * 2, length + count, 256}));
+        
+    }
+    
+public:
+    
+    XMLContainerSink(T& container_) : container(&container_), length(container_.size()) {}
+    
+    void write(const char* data, std::size_t count) {
+        
+        // The container may still be empty, with no element to point to
+        if(!count) return;
+        if(container->size() - length < count) grow(count);
+        std::memcpy(&(*container)[0] + length, data, count);
+        length += count;
+        
+    }
+    void flush() { container->resize(length); }
+    
+    std::size_t getLength() const { return length; }
+    T& getContainer() { return *container; }
+    
+};
+
+using XMLStringSink = XMLContainerSink<std::string>;
+using XMLVectorSink = XMLContainerSink<std::vector<char>>;
+
+// Writes into a buffer of fixed size. Output that does not fit is dropped,
+// but still counted, so getLength() is the size the whole output needs.
+class XMLBufferSink {
+    
+private:
+    
+    char* data;
+    std::size_t capacity;
+    std::size_t length;
+    
+public:
+    
+    XMLBufferSink(char* data_, std::size_t capacity_) : data(data_), capacity(capacity_), length() {}
+    
+    void write(const char* src, std::size_t count) {
+        
+        if(length < capacity) std::memcpy(data + length, src, std::min(count, capacity - length));
+        length += count;
+        
+    }
+    void flush() {}
+    
+    char* getData() const { return data; }
+    std::size_t getCapacity() const { return capacity; }
+    std::size_t getLength() const { return length; }
+    bool isOverflow() const { return length > capacity; }
+    
+};
+
+// Only counts the output, e.g. to allocate a buffer of the exact size
+class XMLCountingSink {
+    
+private:
+    
+    std::size_t length;
+    
+public:
+    
+    XMLCountingSink() : length() {}
+    
+    void write(const char* /*data*/, std::size_t count) { length += count; }
+    void flush() {}
+    
+    std::size_t getLength() const { return length; }
+    
+};
+
+// Collects the output in a buffer and writes it to a file descriptor in
+// large blocks. Failed writes throw std::system_error.
+class XMLFileSink {
+    
+public:
+    
+    static constexpr std::size_t DefaultBufferSize = 65536;
+    
+private:
+    
+    int fd;
+    std::unique_ptr<char[]> buffer;
+    std::size_t capacity;
+    std::size_t size;
+    
+private:
+    
+    void writeAll(const char* src, std::size_t count) { Impl::writeFile(fd, src, count, "XMLFileSink: write failed"); }
+    
+public:
+    
+    XMLFileSink(int fd_, std::size_t capacity_ = DefaultBufferSize) :
+        fd(fd_), buffer(new char[capacity_ ? capacity_ : 1]), capacity(capacity_ ? capacity_ : 1), size() {}
+    XMLFileSink(XMLFileSink&& src) = default;
+    
+    void write(const char* src, std::size_t count) {
+        
+        if(capacity - size < count) {
+            
+            flush();
+            if(count >= capacity) { writeAll(src, count); return; }
+            
+        }
+        std::memcpy(buffer.get() + size, src, count);
+        size += count;
+        
+    }
+    void flush() {
+        
+        if(size) writeAll(buffer.get(), size);
+        size = 0;
+        
+    }
+    
+    int getFileDescriptor() const { return fd; }
+    
+};
+
+#if defined(_WIN32)
+// Laid out like struct iovec
+struct XMLIovec {
+    
+    void* iov_base;
+    std::size_t iov_len;
+    
+};
+#else
+using XMLIovec = ::iovec;
+#endif
+
+// Collects the output as a list of XMLIovec for writev() instead of copying
+// it into one buffer. Data given to reference() is pointed to where it is,
+// so it has to stay valid until the list has been used; when a document is
+// serialized, that is the buffer it was parsed from. Data given to write()
+// and spans shorter than the copy threshold, which would cost more as
+// vectors of their own, are copied into blocks owned by the sink. The list
+// is complete after flush(), which BasicXMLSerializer calls at
+// endDocument().
+class XMLIovecSink {
+    
+public:
+    
+    static constexpr std::size_t DefaultCopyThreshold = 32;
+    static constexpr std::size_t BlockSize = 16384;
+    
+private:
+    
+    std::vector<XMLIovec> vectors;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    // Blocks in use, the last of them at current, filled up to size. The
+    // data copied since start has no vector yet.
+    std::size_t used;
+    char* current;
+    std::size_t start;
+    std::size_t size;
+    std::size_t length;
+    std::size_t copyThreshold;
+    
+private:
+    
+    // Adds a vector, or extends the last one if the data follows it. Empty
+    // data adds nothing.
+    void append(const char* data, std::size_t count) {
+        
+        if(!count) return;
+        if(!vectors.empty()) {
+            
+            auto& last = vectors.back();
+            if(static_cast<const char*>(last.iov_base) + last.iov_len == data) { last.iov_len += count; return; }
+            
+        }
+        XMLIovec vector;
+        vector.iov_base = const_cast<char*>(data);
+        vector.iov_len = count;
+        vectors.push_back(vector);
+        
+    }
+    // Adds a vector for the data copied since the last one
+    void settle() {
+        
+        if(size != start) append(current + start, size - start);
+        start = size;
+        
+    }
+    // Adds a vector pointing to the data
+    CATS_TEXTCAT_XML_NOINLINE void point(const char* data, std::size_t count) {
+        
+        settle();
+        append(data, count);
+        
+    }
+    // Copies data that does not fit into the current block
+    CATS_TEXTCAT_XML_NOINLINE void writeLarge(const char* data, std::size_t count) {
+        
+        while(BlockSize - size < count) {
+            
+            const std::size_t n = BlockSize - size;
+            std::memcpy(current + size, data, n);
+            size = BlockSize;
+            data += n;
+            count -= n;
+            nextBlock();
+            
+        }
+        std::memcpy(current + size, data, count);
+        size += count;
+        
+    }
+    // Continues in the next block, allocating it if no free one is left
+    void nextBlock() {
+        
+        settle();
+        if(used == blocks.size()) blocks.emplace_back(new char[BlockSize]);
+        current = blocks[used++].get();
+        start = size = 0;
+        
+    }
+    
+public:
+    
+    XMLIovecSink(std::size_t copyThreshold_ = DefaultCopyThreshold) :
+        used(), current(), start(), size(), length(), copyThreshold(copyThreshold_) { nextBlock(); }
+    XMLIovecSink(XMLIovecSink&& src) = default;
+    XMLIovecSink& operator =(XMLIovecSink&& src) = default;
+    
+    void write(const char* data, std::size_t count) {
+        
+        if(BlockSize - size < count) writeLarge(data, count);
+        else {
+            
+            std::memcpy(current + size, data, count);
+            size += count;
+            
+        }
+        length += count;
+        
+    }
+    void reference(const char* data, std::size_t count) {
+        
+        if(count < copyThreshold) write(data, count);
+        else {
+            
+            point(data, count);
+            length += count;
+            
+        }
+        
+    }
+    void flush() { settle(); }
+    
+    // Empties the list and keeps the blocks for the next output
+    void clear() {
+        
+        vectors.clear();
+        used = 0;
+        start = size = 0;
+        length = 0;
+        nextBlock();
+        
+    }
+    // Writes the output to a file descriptor, with writev() where it is
+    // available, and clears the sink. Failed writes throw std::system_error.
+    void writeTo(int fd) {
+        
+        settle();
+#if defined(_WIN32)
+        for(auto& vector : vectors)
+            Impl::writeFile(fd, static_cast<const char*>(vector.iov_base), vector.iov_len, "XMLIovecSink: write failed");
+#else
+#   if defined(IOV_MAX)
+        constexpr std::size_t maxCount = IOV_MAX;
+#   else
+        constexpr std::size_t maxCount = 1024;
+#   endif
+        for(std::size_t i = 0; i != vectors.size(); ) {
+            
+            const auto result = ::writev(fd, vectors.data() + i, static_cast<int>(std::min(vectors.size() - i, maxCount)));
+            if(result < 0) {
+                
+                if(errno == EINTR) continue;
+                throw std::system_error(errno, std::generic_category(), "XMLIovecSink: writev failed");
+                
+            }
+            // Skips what was written; a vector written in part is adjusted
+            // to its rest
+            for(std::size_t n = result; i != vectors.size(); ++i) {
+                
+                auto& vector = vectors[i];
+                if(n < vector.iov_len) {
+                    
+                    vector.iov_base = static_cast<char*>(vector.iov_base) + n;
+                    vector.iov_len -= n;
+                    break;
+                    
+                }
+                n -= vector.iov_len;
+                
+            }
+            // Nothing written while something is left would loop forever
+            if(!result && i != vectors.size())
+                throw std::system_error(EIO, std::generic_category(), "XMLIovecSink: writev wrote nothing");
+            
+        }
+#endif
+        clear();
+        
+    }
+    
+    const std::vector<XMLIovec>& getVectors() const { return vectors; }
+    std::size_t getLength() const { return length; }
+    std::size_t getCopyThreshold() const { return copyThreshold; }
+    void setCopyThreshold(std::size_t copyThreshold_) { copyThreshold = copyThreshold_; }
+    
+};
+
+}
+}
+}
+
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CATS_TEXTCAT_XML_STRUCTURALINDEX_HPP
+#define CATS_TEXTCAT_XML_STRUCTURALINDEX_HPP
+
+
+#include <cassert>
+#include <cstdint>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "Document.hpp"
+#include "Parser.hpp"
+
+
+namespace Cats {
+namespace Textcat{
+inline namespace XML {
+
+namespace Impl {
+
+#if defined(CATS_TEXTCAT_XML_SSE2)
+
+// Bits of the 32 bytes at t that are '<', '&' or null characters
+inline std::uint32_t structuralMask(const char* t) {
+
+#if defined(CATS_TEXTCAT_XML_AVX2)
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(t));
+    const __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('<')),
+        _mm256_cmpeq_epi8(x, _mm256_set1_epi8('&'))), _mm256_cmpeq_epi8(x, _mm256_setzero_si256()));
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(m));
+#else
+    const __m128i x0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t));
+    const __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + 16));
+    const __m128i m0 = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x0, _mm_set1_epi8('<')),
+        _mm_cmpeq_epi8(x0, _mm_set1_epi8('&'))), _mm_cmpeq_epi8(x0, _mm_setzero_si128()));
+    const __m128i m1 = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x1, _mm_set1_epi8('<')),
+        _mm_cmpeq_epi8(x1, _mm_set1_epi8('&'))), _mm_cmpeq_epi8(x1, _mm_setzero_si128()));
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(m0)) | static_cast<std::uint32_t>(_mm_movemask_epi8(m1)) << 16;
+#endif
+
+}
+
+#endif
+
+}
+
+// The offsets of every '<', '&' and null character in a piece of data,
+// found 64 bytes at a time. Parsing through the index takes the end of each
+// text from it instead of scanning the text again, and the index can be
+// kept to parse single elements of the data later. The data must stay
+// alive and unchanged while the index is used.
+class XMLStructuralIndex {
+    
+private:
+    
+    using Flag = XMLParser::Flag;
+    
+private:
+    
+    const char* data;
+    std::size_t length;
+    std::vector<std::uint32_t> positions;
+    
+private:
+    
+    static bool isStructural(char c) { return c == '<' || c == '&' || !c; }
+    
+    void start(XMLParser& parser, std::size_t offset) const {
+        
+        parser.clearArena();
+        parser.s = const_cast<char*>(data);
+        parser.p = const_cast<char*>(data + offset);
+        parser.e = const_cast<char*>(data + length);
+        parser.skipping = false;
+        parser.cursor = positions.data() + find(offset);
+        parser.indexEnd = positions.data() + positions.size();
+        
+    }
+    
+public:
+    
+    XMLStructuralIndex() : data(), length(), positions() {}
+    XMLStructuralIndex(const char* data_, std::size_t length_) : data(), length(), positions() { build(data_, length_); }
+    XMLStructuralIndex(const XMLStructuralIndex& src) = delete;
+    
+    const char* getData() const { return data; }
+    std::size_t getLength() const { return length; }
+    const std::vector<std::uint32_t>& getPositions() const { return positions; }
+    
+    // Index of the first position at or after offset
+    std::size_t find(std::size_t offset) const {
+        
+        return std::lower_bound(positions.begin(), positions.end(), offset) - positions.begin();
+        
+    }
+    
+    void build(const char* data_, std::size_t length_) {
+        
+        assert(data_ || !length_);
+        
+        if(length_ > std::numeric_limits<std::uint32_t>::max())
+            throw std::length_error("XMLStructuralIndex: data larger than 4 GiB");
+        data = data_;
+        length = length_;
+        positions.clear();
+        std::size_t count = 0;
+        std::size_t i = 0;
+#if defined(CATS_TEXTCAT_XML_SSE2)
+        for(; length - i >= 64; i += 64) {
+            
+            std::uint32_t mask[2] = {Impl::structuralMask(data + i), Impl::structuralMask(data + i + 32)};
+            if(!(mask[0] | mask[1])) continue;
+            if(positions.size() - count < 64) positions.resize(std::max<std::size_t>(positions.size() * 2, 1024));
+            for(std::size_t j = 0; j < 2; ++j)
+                for(auto m = mask[j]; m; m &= m - 1)
+                    positions[count++] = static_cast<std::uint32_t>(i + j * 32 + Impl::countTrailingZero(m));
+            
+        }
+#endif
+        positions.resize(count);
+        for(; i < length; ++i) if(isStructural(data[i])) positions.push_back(static_cast<std::uint32_t>(i));
+        
+    }
+    
+    // Parses the whole data like XMLParser::parse() on read-only data
+    template <Flag F = Flag::Default, typename H>
+    void parse(XMLParser& parser, H& handler) const {
+        
+        start(parser, 0);
+        parser.parseDocument<F | Flag::NonDestructive | XMLParser::Bounded | XMLParser::Indexed>(handler);
+        
+    }
+    // Parses the element whose start tag begins at offset as a document of
+    // its own. Nothing before or after the element is looked at.
+    template <Flag F = Flag::Default, typename H>
+    void parseElement(XMLParser& parser, std::size_t offset, H& handler) const {
+        
+        constexpr Flag G = F | Flag::NonDestructive | XMLParser::Bounded | XMLParser::Indexed;
+        
+        if(offset >= length || data[offset] != '<') throw XMLParseException("Expected <", offset);
+        start(parser, offset + 1);
+        handler.startDocument();
+        parser.parseElement<G>(handler);
+        handler.endDocument();
+        
+    }
+    // Parses the whole data into document, which references it like with
+    // Flag::NonDestructive
+    template <Flag F = Flag::Default>
+    void parse(XMLDocument& document) const {
+        
+        document.clear();
+        XMLParser parser(document.allocator);
+        XMLDocument::Builder builder(&document, &parser);
+        parse<F>(parser, builder);
+        
+    }
+    // Parses only the element starting at offset into document
+    template <Flag F = Flag::Default>
+    void parseElement(std::size_t offset, XMLDocument& document) const {
+        
+        document.clear();
+        XMLParser parser(document.allocator);
+        XMLDocument::Builder builder(&document, &parser);
+        parseElement<F>(parser, offset, builder);
+        
+    }
+    
+};
+
+}
+}
+}
+
+
+#endif
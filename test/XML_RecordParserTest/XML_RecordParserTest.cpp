@@ -0,0 +1,119 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2016-2018 The Cats Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "Cats/Textcat/XML.hpp"
+
+using namespace Cats::Corecat;
+using namespace Cats::Textcat;
+
+std::string generate(std::size_t count, std::size_t bad, bool malformed) {
+    
+    std::string data = "<records>";
+    for(std::size_t i = 0; i < count; ++i) {
+        
+        // A large malformed record is still parsing when the others wait
+        if(i == bad && malformed) data += "<a>" + std::string(16 << 20, 'x') + "</b>";
+        else data += "<record id=\"" + std::to_string(i) + "\">text</record>";
+        
+    }
+    data += "</records>";
+    return data;
+
+}
+
+// Checks that a failing record stops the parse with its exception instead of
+// leaving the later records waiting for their turn. A failure shows as a
+// hang, which the test timeout catches.
+template <typename E, typename C>
+void checkError(const char* name, const std::string& data, bool ordered, C callback) {
+    
+    XMLRecordParser parser(4);
+    parser.setOrdered(ordered);
+    try {
+        
+        parser.parse<>(data.data(), data.size(), callback);
+        
+    } catch(E&) {
+        
+        std::cout << name << ": OK" << std::endl;
+        return;
+        
+    }
+    throw std::runtime_error(std::string(name) + ": no exception");
+
+}
+
+int main() {
+    
+    try {
+        
+        const std::size_t count = 1000, bad = 3;
+        const auto good = generate(count, bad, false);
+        const auto malformed = generate(count, bad, true);
+        
+        for(bool ordered : {false, true}) {
+            
+            std::cout << (ordered ? "Ordered" : "Unordered") << std::endl;
+            checkError<std::logic_error>("  Callback throws", good, ordered, [&](std::size_t i, XMLDocument&) {
+                
+                // Gives the other threads time to wait for their turns
+                if(i == bad) {
+                    
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    throw std::logic_error("Callback failed");
+                    
+                }
+                
+            });
+            checkError<XMLParseException>("  Malformed record", malformed, ordered, [](std::size_t, XMLDocument&) {});
+            
+            // Without errors every record is delivered, in order if asked
+            XMLRecordParser parser(4);
+            parser.setOrdered(ordered);
+            std::atomic<std::size_t> delivered(0);
+            std::atomic<bool> inOrder(true);
+            parser.parse<>(good.data(), good.size(), [&](std::size_t i, XMLDocument&) {
+                
+                if(delivered++ != i) inOrder = false;
+                
+            });
+            if(delivered != count || (ordered && !inOrder)) throw std::runtime_error("  Records lost or out of order");
+            std::cout << "  All records: OK" << std::endl;
+            
+        }
+        
+    } catch(std::exception& e) { std::cerr << e.what() << std::endl; return 1; }
+    
+    return 0;
+
+}